@@ -4,6 +4,13 @@
 #include <string.h>
 
 #include "os.h"
+#include "trace.h"
+#include "metrics.h"
+
+#if COLLA_ALLOC_PROFILE
+#include <math.h>
+#include <stdlib.h>
+#endif
 
 static uptr arena__align(uptr ptr, usize align) {
     return (ptr + (align - 1)) & ~(align - 1);
@@ -19,6 +26,10 @@ static void *arena__alloc_malloc_always(const arena_alloc_desc_t *desc);
 static void arena__free_virtual(arena_t *arena);
 static void arena__free_malloc(arena_t *arena);
 
+#if COLLA_ALLOC_PROFILE
+static void arena__profile_sample(const arena_alloc_desc_t *desc, usize total);
+#endif
+
 arena_t malloc_arena = {
     .type = ARENA_MALLOC_ALWAYS,
 };
@@ -78,6 +89,12 @@ void *arena_alloc(const arena_alloc_desc_t *desc) {
 
     usize total = desc->size * desc->count;
 
+#if COLLA_ALLOC_PROFILE
+    if (ptr && desc->file) {
+        arena__profile_sample(desc, total);
+    }
+#endif
+
     return desc->flags & ALLOC_NOZERO ? ptr : memset(ptr, 0, total);
 }
 
@@ -123,6 +140,10 @@ static arena_t arena__make_virtual(usize size) {
         os_release(ptr, alloc_size);
         ptr = NULL;
     }
+    else {
+        metrics_add(metrics_colla.arena_commits, 1);
+        metrics_add(metrics_colla.arena_commit_bytes, os_get_system_info().page_size);
+    }
 
     return (arena_t){
         .beg = ptr,
@@ -189,12 +210,19 @@ static void *arena__alloc_common(const arena_alloc_desc_t *desc) {
 
             assert(num_of_pages > 0);
 
-            if (!os_commit(arena->cur, num_of_pages + 1)) {
+            TRACE_BEGIN("arena commit");
+            bool committed = os_commit(arena->cur, num_of_pages + 1);
+            TRACE_END();
+
+            if (!committed) {
                 if (!soft_fail) {
                     fatal("failed to commit memory for virtual arena, tried to commit %zu pages\n", num_of_pages);
                 }
                 return NULL;
             }
+
+            metrics_add(metrics_colla.arena_commits, 1);
+            metrics_add(metrics_colla.arena_commit_bytes, (num_of_pages + 1) * page_size);
         }
     }
 
@@ -228,3 +256,203 @@ static arena_t arena__make_static(u8 *buf, usize len) {
     };
 }
 
+// == ALLOCATION PROFILER ==============================================================================================
+
+#if COLLA_ALLOC_PROFILE
+
+#define ARENA__PROFILE_SITES        (4096)
+#define ARENA__PROFILE_DEFAULT_RATE (KB(512))
+
+typedef struct arena__site_t arena__site_t;
+struct arena__site_t {
+    const char *file;
+    int line;
+    const char *type_name;
+    double count;
+    double bytes;
+    u64 samples;
+};
+
+typedef struct arena__profile_local_t arena__profile_local_t;
+struct arena__profile_local_t {
+    u64 rng;
+    i64 until_sample;
+};
+
+// sites are only touched when an allocation is sampled, a lock is plenty
+struct {
+    volatile u64 rate;
+    os_lock_t lock;
+    u32 site_count;
+    u64 dropped;
+    arena__site_t sites[ARENA__PROFILE_SITES];
+} arena__profile = {
+    .rate = ARENA__PROFILE_DEFAULT_RATE,
+};
+
+static COLLA_THREAD_LOCAL arena__profile_local_t arena__profile_local = {0};
+
+// exponential distance to the next sample, so the samples don't line up with
+// allocation patterns
+static i64 arena__profile_next(arena__profile_local_t *local, u64 rate) {
+    local->rng ^= local->rng << 13;
+    local->rng ^= local->rng >> 7;
+    local->rng ^= local->rng << 17;
+    double uniform = (double)((local->rng >> 11) + 1) / 9007199254740992.0;
+    return (i64)(-log(uniform) * (double)rate) + 1;
+}
+
+static u32 arena__profile_hash(const char *file, int line) {
+    u32 hash = 2166136261u;
+    for (const char *c = file; *c; ++c) {
+        hash = (hash ^ (u8)*c) * 16777619u;
+    }
+    return (hash ^ (u32)line) * 16777619u;
+}
+
+static void arena__profile_sample(const arena_alloc_desc_t *desc, usize total) {
+    arena__profile_local_t *local = &arena__profile_local;
+    u64 rate = atomic_load_u64(&arena__profile.rate, ATOMIC_RELAXED);
+
+    if (!rate || !total) {
+        return;
+    }
+
+    if (!local->rng) {
+        local->rng = ((u64)(uptr)local ^ os_now_ns()) | 1;
+        local->until_sample = arena__profile_next(local, rate);
+    }
+
+    local->until_sample -= (i64)total;
+    if (local->until_sample > 0) {
+        return;
+    }
+    local->until_sample = arena__profile_next(local, rate);
+
+    // inverse of the probability of picking this allocation
+    double weight = 1.0 / (1.0 - exp(-(double)total / (double)rate));
+
+    u32 mask = ARENA__PROFILE_SITES - 1;
+    u32 index = arena__profile_hash(desc->file, desc->line) & mask;
+
+    os_lock_acquire(&arena__profile.lock);
+
+    arena__site_t *site = NULL;
+    for (u32 i = 0; i < ARENA__PROFILE_SITES; ++i) {
+        arena__site_t *it = &arena__profile.sites[(index + i) & mask];
+        if (!it->file) {
+            // keep the table at most 3/4 full so probes stay short
+            if ((arena__profile.site_count + 1) * 4 <= ARENA__PROFILE_SITES * 3) {
+                site = it;
+                site->file = desc->file;
+                site->line = desc->line;
+                site->type_name = desc->type_name;
+                arena__profile.site_count++;
+            }
+            break;
+        }
+        if (it->line == desc->line && (it->file == desc->file || strcmp(it->file, desc->file) == 0)) {
+            site = it;
+            break;
+        }
+    }
+
+    if (site) {
+        site->count += weight;
+        site->bytes += weight * (double)total;
+        site->samples++;
+    }
+    else {
+        arena__profile.dropped++;
+    }
+
+    os_lock_release(&arena__profile.lock);
+}
+
+void arena_profile_set_rate(usize bytes) {
+    atomic_store_u64(&arena__profile.rate, bytes, ATOMIC_RELAXED);
+}
+
+void arena_profile_reset(void) {
+    os_lock_acquire(&arena__profile.lock);
+    memset(arena__profile.sites, 0, sizeof(arena__profile.sites));
+    arena__profile.site_count = 0;
+    arena__profile.dropped = 0;
+    os_lock_release(&arena__profile.lock);
+}
+
+static int arena__profile_cmp(const void *a, const void *b) {
+    u64 bytes_a = ((const arena_site_t *)a)->bytes;
+    u64 bytes_b = ((const arena_site_t *)b)->bytes;
+    return (bytes_a < bytes_b) - (bytes_a > bytes_b);
+}
+
+arena_site_t *arena_profile_sites(arena_t *arena, usize *out_count) {
+    // allocated before taking the lock, the allocation itself could be sampled
+    arena_site_t *sites = alloc(arena, arena_site_t, ARENA__PROFILE_SITES);
+    usize count = 0;
+
+    os_lock_acquire(&arena__profile.lock);
+    for (u32 i = 0; i < ARENA__PROFILE_SITES; ++i) {
+        arena__site_t *site = &arena__profile.sites[i];
+        if (!site->file) continue;
+        sites[count++] = (arena_site_t){
+            .file = site->file,
+            .line = site->line,
+            .type_name = site->type_name,
+            .count = (u64)(site->count + 0.5),
+            .bytes = (u64)(site->bytes + 0.5),
+            .samples = site->samples,
+        };
+    }
+    os_lock_release(&arena__profile.lock);
+
+    qsort(sites, count, sizeof(*sites), arena__profile_cmp);
+
+    if (out_count) *out_count = count;
+    return sites;
+}
+
+void arena_profile_print(usize max_sites) {
+    arena_t arena = arena_make(ARENA_VIRTUAL, MB(16));
+
+    usize count = 0;
+    arena_site_t *sites = arena_profile_sites(&arena, &count);
+    if (max_sites) {
+        count = MIN(count, max_sites);
+    }
+
+    print("%12s  %12s  %8s  %s\n", "bytes", "count", "samples", "site");
+    for (usize i = 0; i < count; ++i) {
+        arena_site_t *site = &sites[i];
+        print("%$$$11lluB  %12llu  %8llu  %s:%d (%s)\n", site->bytes, site->count, site->samples, site->file, site->line, site->type_name);
+    }
+
+    if (arena__profile.dropped) {
+        warn("allocation profiler table is full, %llu samples were dropped", arena__profile.dropped);
+    }
+
+    arena_cleanup(&arena);
+}
+
+#else
+
+void arena_profile_set_rate(usize bytes) {
+    COLLA_UNUSED(bytes);
+}
+
+void arena_profile_reset(void) {
+}
+
+arena_site_t *arena_profile_sites(arena_t *arena, usize *out_count) {
+    COLLA_UNUSED(arena);
+    if (out_count) *out_count = 0;
+    return NULL;
+}
+
+void arena_profile_print(usize max_sites) {
+    COLLA_UNUSED(max_sites);
+    warn("allocation profiling is disabled, define COLLA_ALLOC_PROFILE to 1");
+}
+
+#endif
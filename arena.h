@@ -43,13 +43,27 @@ struct arena_alloc_desc_t {
     alloc_flags_e flags;
     usize align;
     usize size;
+    // call site, only filled in by alloc() when COLLA_ALLOC_PROFILE is 1
+    const char *file;
+    int line;
+    const char *type_name;
 };
 
+// allocation profiling is compiled out unless COLLA_ALLOC_PROFILE is defined
+// to 1 before including colla
+#ifndef COLLA_ALLOC_PROFILE
+#define COLLA_ALLOC_PROFILE 0
+#endif
+
 // arena_type_e type, usize allocation, [ byte *static_buffer ]
 #define arena_make(...) arena_init(&(arena_desc_t){ __VA_ARGS__ })
 
 // arena_t *arena, T type, [ usize count, alloc_flags_e flags, usize align, usize size ]
+#if COLLA_ALLOC_PROFILE
+#define alloc(arenaptr, type, ...) arena_alloc(&(arena_alloc_desc_t){ .size = sizeof(type), .count = 1, .align = alignof(type), .file = __FILE__, .line = __LINE__, .type_name = #type, .arena = arenaptr, __VA_ARGS__ })
+#else
 #define alloc(arenaptr, type, ...) arena_alloc(&(arena_alloc_desc_t){ .size = sizeof(type), .count = 1, .align = alignof(type), .arena = arenaptr, __VA_ARGS__ })
+#endif
 
 // simple arena that always calls malloc internally, this is useful if you need
 // malloc for some reason but want to still use the arena interface
@@ -70,4 +84,29 @@ usize arena_capacity(arena_t *arena);
 void arena_rewind(arena_t *arena, usize from_start);
 void arena_pop(arena_t *arena, usize amount);
 
+// ALLOCATION PROFILER //////////////////////////
+
+// with COLLA_ALLOC_PROFILE, every thread samples about one allocation every
+// `rate` bytes (an allocation of n bytes is picked with probability
+// 1 - e^(-n/rate)) and adds it to its call site, weighted so that the totals
+// estimate every allocation made there
+
+typedef struct arena_site_t arena_site_t;
+struct arena_site_t {
+    const char *file;
+    int line;
+    const char *type_name;
+    u64 count;   // estimated number of allocations
+    u64 bytes;   // estimated bytes allocated
+    u64 samples; // allocations that were actually recorded
+};
+
+// defaults to KB(512), 0 stops sampling
+void arena_profile_set_rate(usize bytes);
+void arena_profile_reset(void);
+// every site seen so far, sorted by bytes
+arena_site_t *arena_profile_sites(arena_t *arena, usize *out_count);
+// prints a table of the top max_sites sites (0 for all of them)
+void arena_profile_print(usize max_sites);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "bench.h"
+#include "os.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#define BENCH__DEFAULT_SAMPLES   (50)
+#define BENCH__DEFAULT_SAMPLE_NS (2 * 1000 * 1000)
+#define BENCH__DEFAULT_WARMUP_NS (100 * 1000 * 1000)
+#define BENCH__DEFAULT_SCRATCH   (MB(64))
+// never grow the iteration count by more than this in one go, the first
+// rounds are usually slower than the rest
+#define BENCH__MAX_SCALE         (100)
+
+#if COLLA_MSVC
+volatile void *bench__sink = NULL;
+
+void bench_escape(void *ptr) {
+    bench__sink = ptr;
+    _ReadWriteBarrier();
+}
+#else
+void bench_escape(void *ptr) {
+    __asm__ __volatile__("" : : "r"(ptr) : "memory");
+}
+#endif
+
+bench_runner_t bench_init(arena_t *arena, const bench_desc_t *desc) {
+    bench_desc_t opts = desc ? *desc : (bench_desc_t){0};
+
+    if (!opts.samples)      opts.samples      = BENCH__DEFAULT_SAMPLES;
+    if (!opts.sample_ns)    opts.sample_ns    = BENCH__DEFAULT_SAMPLE_NS;
+    if (!opts.warmup_ns)    opts.warmup_ns    = BENCH__DEFAULT_WARMUP_NS;
+    if (!opts.scratch_size) opts.scratch_size = BENCH__DEFAULT_SCRATCH;
+
+    return (bench_runner_t){
+        .arena = arena,
+        .scratch = arena_make(ARENA_VIRTUAL, opts.scratch_size),
+        .desc = opts,
+    };
+}
+
+void bench_cleanup(bench_runner_t *runner) {
+    arena_cleanup(&runner->scratch);
+}
+
+u64 bench__time(bench_t *b, bench_func_t *func, void *userdata) {
+    u64 start = os_now_ns();
+    func(b, userdata);
+    return os_now_ns() - start;
+}
+
+int bench__cmp_double(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+bench_result_t *bench_run(bench_runner_t *runner, strview_t name, bench_func_t *func, void *userdata) {
+    bench_desc_t *desc = &runner->desc;
+
+    if (desc->filter.len && !strv_contains_view(name, desc->filter)) {
+        return NULL;
+    }
+
+    bench_t b = {
+        .iterations = 1,
+        .arena = &runner->scratch,
+    };
+
+    // keep going until the code is warm and a sample is long enough to time
+    u64 warmup_start = os_now_ns();
+    while (true) {
+        u64 elapsed = bench__time(&b, func, userdata);
+        bool long_enough = elapsed >= desc->sample_ns;
+
+        if (long_enough && (os_now_ns() - warmup_start) >= desc->warmup_ns) {
+            break;
+        }
+
+        if (!long_enough) {
+            // aim a bit over the target so we don't stop just short of it
+            u64 scale = elapsed ? (desc->sample_ns + desc->sample_ns / 5) / elapsed : BENCH__MAX_SCALE;
+            scale = MIN(MAX(scale, 2), BENCH__MAX_SCALE);
+            b.iterations *= scale;
+        }
+    }
+
+    // the result goes first so the samples after it are free scratch memory
+    bench_result_t *result = alloc(runner->arena, bench_result_t);
+    result->name = str(runner->arena, name);
+    arena_t scratch = *runner->arena;
+    double *samples = alloc(&scratch, double, desc->samples, ALLOC_NOZERO);
+    double sum = 0;
+
+    for (u32 i = 0; i < desc->samples; ++i) {
+        samples[i] = (double)bench__time(&b, func, userdata) / (double)b.iterations;
+        sum += samples[i];
+    }
+
+    qsort(samples, desc->samples, sizeof(*samples), bench__cmp_double);
+
+    double mean = sum / desc->samples;
+    double variance = 0;
+    for (u32 i = 0; i < desc->samples; ++i) {
+        double diff = samples[i] - mean;
+        variance += diff * diff;
+    }
+    variance /= desc->samples > 1 ? desc->samples - 1 : 1;
+
+    u32 median_index = desc->samples / 2;
+    u32 p99_index = (u32)ceil(desc->samples * 0.99) - 1;
+
+    double median = samples[median_index];
+    if ((desc->samples & 1) == 0) {
+        median = (samples[median_index - 1] + samples[median_index]) / 2.0;
+    }
+
+    *result = (bench_result_t){
+        .name = result->name,
+        .iterations = b.iterations,
+        .samples = desc->samples,
+        .min_ns = samples[0],
+        .median_ns = median,
+        .p99_ns = samples[p99_index],
+        .mean_ns = mean,
+        .stddev_ns = sqrt(variance),
+        .bytes_per_sec = median > 0 ? (double)b.bytes * 1e9 / median : 0,
+        .items_per_sec = median > 0 ? (double)b.items * 1e9 / median : 0,
+    };
+
+    if (!runner->results) {
+        runner->results = result;
+    }
+    else {
+        runner->tail->next = result;
+    }
+    runner->tail = result;
+
+    return result;
+}
+
+void bench__print_time(double ns) {
+    if (ns < 1e3)      print("%9.2f ns", ns);
+    else if (ns < 1e6) print("%9.2f us", ns / 1e3);
+    else if (ns < 1e9) print("%9.2f ms", ns / 1e6);
+    else               print("%9.2f s ", ns / 1e9);
+}
+
+void bench_print(bench_runner_t *runner) {
+    usize name_width = 4;
+    for_each (res, runner->results) {
+        name_width = MAX(name_width, res->name.len);
+    }
+
+    print("%-*s  %12s  %12s  %12s  %12s  %14s  %14s\n", (int)name_width, "name", "min", "median", "p99", "stddev", "bytes/sec", "items/sec");
+
+    for_each (res, runner->results) {
+        print("%-*v  ", (int)name_width, res->name);
+        bench__print_time(res->min_ns);    print("  ");
+        bench__print_time(res->median_ns); print("  ");
+        bench__print_time(res->p99_ns);    print("  ");
+        bench__print_time(res->stddev_ns); print("  ");
+
+        if (res->bytes_per_sec > 0) print("%10.1f MB/s", res->bytes_per_sec / (1024.0 * 1024.0));
+        else                        print("%15s", "-");
+        if (res->items_per_sec > 0) print("%13.1f M/s\n", res->items_per_sec / 1e6);
+        else                        print("%17s\n", "-");
+    }
+}
+
+str_t bench_to_json(arena_t *arena, bench_runner_t *runner) {
+    outstream_t out = ostr_init(arena);
+
+    ostr_puts(&out, strv("{\n  \"benchmarks\": [\n"));
+
+    for_each (res, runner->results) {
+        ostr_print(
+            &out,
+            "    {\n"
+            "      \"name\": \"%v\",\n"
+            "      \"iterations\": %llu,\n"
+            "      \"samples\": %u,\n"
+            "      \"min_ns\": %.3f,\n"
+            "      \"median_ns\": %.3f,\n"
+            "      \"p99_ns\": %.3f,\n"
+            "      \"mean_ns\": %.3f,\n"
+            "      \"stddev_ns\": %.3f,\n"
+            "      \"bytes_per_sec\": %.1f,\n"
+            "      \"items_per_sec\": %.1f\n"
+            "    }%s\n",
+            res->name,
+            res->iterations,
+            res->samples,
+            res->min_ns,
+            res->median_ns,
+            res->p99_ns,
+            res->mean_ns,
+            res->stddev_ns,
+            res->bytes_per_sec,
+            res->items_per_sec,
+            res->next ? "," : ""
+        );
+    }
+
+    ostr_puts(&out, strv("  ]\n}\n"));
+
+    return ostr_to_str(&out);
+}
+
+bool bench_write_json(bench_runner_t *runner, strview_t filename) {
+    arena_t scratch = runner->scratch;
+    str_t json = bench_to_json(&scratch, runner);
+    return os_file_write_all_str(filename, strv(json));
+}
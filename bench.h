@@ -0,0 +1,93 @@
+#ifndef COLLA_BENCH_H
+#define COLLA_BENCH_H
+
+#include "core.h"
+#include "str.h"
+#include "arena.h"
+
+// microbenchmark harness, it is not part of build.c: include bench.c next to
+// build.c in the program that runs the benchmarks (see tools/bench.c)
+//
+// a benchmark runs its body b->iterations times, the harness warms it up,
+// scales the iteration count until one sample takes at least sample_ns and
+// then times every sample:
+//
+//     void bench_find(bench_t *b, void *userdata) {
+//         strview_t text = *(strview_t *)userdata;
+//         b->bytes = text.len;
+//         for (u64 i = 0; i < b->iterations; ++i) {
+//             usize pos = strv_find(text, '!', 0);
+//             bench_do_not_optimise(pos);
+//         }
+//     }
+
+typedef struct bench_t bench_t;
+struct bench_t {
+    u64 iterations;
+    // set these to get throughput numbers, they are per iteration
+    u64 bytes;
+    u64 items;
+    // free to use, copy it inside the loop to reset it every iteration:
+    // arena_t scratch = *b->arena;
+    arena_t *arena;
+};
+
+typedef void (bench_func_t)(bench_t *b, void *userdata);
+
+// all times are per iteration, in nanoseconds
+typedef struct bench_result_t bench_result_t;
+struct bench_result_t {
+    str_t name;
+    u64 iterations; // per sample
+    u32 samples;
+    double min_ns;
+    double median_ns;
+    double p99_ns;
+    double mean_ns;
+    double stddev_ns;
+    double bytes_per_sec;
+    double items_per_sec;
+    bench_result_t *next;
+};
+
+typedef struct bench_desc_t bench_desc_t;
+struct bench_desc_t {
+    u32 samples;        // defaults to 50
+    u64 sample_ns;      // minimum time for one sample, defaults to 2ms
+    u64 warmup_ns;      // defaults to 100ms
+    usize scratch_size; // size of bench_t.arena, defaults to MB(64)
+    strview_t filter;   // only run benchmarks whose name contains this
+};
+
+typedef struct bench_runner_t bench_runner_t;
+struct bench_runner_t {
+    arena_t *arena;
+    arena_t scratch;
+    bench_desc_t desc;
+    bench_result_t *results;
+    bench_result_t *tail;
+};
+
+// arena_t *arena, [ u32 samples, u64 sample_ns, u64 warmup_ns, usize scratch_size, strview_t filter ]
+#define bench_make(arenaptr, ...) bench_init(arenaptr, &(bench_desc_t){ __VA_ARGS__ })
+
+bench_runner_t bench_init(arena_t *arena, const bench_desc_t *desc);
+void bench_cleanup(bench_runner_t *runner);
+
+// returns NULL if the benchmark was skipped by the filter
+bench_result_t *bench_run(bench_runner_t *runner, strview_t name, bench_func_t *func, void *userdata);
+
+void bench_print(bench_runner_t *runner);
+str_t bench_to_json(arena_t *arena, bench_runner_t *runner);
+bool bench_write_json(bench_runner_t *runner, strview_t filename);
+
+// stops the compiler from optimising away the computation of value
+#define bench_do_not_optimise(value) do { \
+        typeof(value) bench__value = (value); \
+        bench_escape(&bench__value); \
+    } while (0)
+
+// makes the compiler assume that ptr (and anything reachable from it) is read
+void bench_escape(void *ptr);
+
+#endif
@@ -6,6 +6,10 @@
 
 #include "core.c"
 #include "os.c"
+#include "trace.c"
+#include "metrics.c"
+#include "jobs.c"
+#include "queue.c"
 #include "arena.c"
 #include "str.c"
 #include "parsers.c"
@@ -1,6 +1,7 @@
 #include "core.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #if COLLA_CLANG
 #pragma clang diagnostic push
@@ -23,11 +24,45 @@ extern void net_init(void);
 extern void os_cleanup(void);
 extern void net_cleanup(void);
 
-static char *colla_fmt__stb_callback(const char *buf, void *ud, int len) {
-    fflush(stdout);
+typedef struct colla_fmt_sink_t colla_fmt_sink_t;
+struct colla_fmt_sink_t {
+    char buf[COLLA_FMT_BUFFER_SIZE];
+    usize len;
+    bool has_newline;
+};
+
+static fmt_flush_e colla__fmt_policy = FMT_FLUSH_LINE;
+static usize colla__fmt_flush_size = 0;
+
+#if COLLA_TCC
+// there are no thread locals, a single sink would be shared (and raced on) by
+// every thread. the text goes to stdio instead, which does its own locking
+static char *colla_fmt__stb_direct(const char *buf, void *ud, int len) {
     fwrite(buf, 1, len, stdout);
     return (char *)ud;
 }
+#else
+static COLLA_THREAD_LOCAL colla_fmt_sink_t colla__fmt_sink = {0};
+
+// stb writes straight into the sink, we only need to move the cursor forward
+// and make sure there is always space for another chunk
+static char *colla_fmt__stb_callback(const char *buf, void *ud, int len) {
+    COLLA_UNUSED(ud);
+    colla_fmt_sink_t *sink = &colla__fmt_sink;
+
+    if (!sink->has_newline && memchr(buf, '\n', len)) {
+        sink->has_newline = true;
+    }
+
+    sink->len += len;
+
+    if ((sink->len + STB_SPRINTF_MIN) > sizeof(sink->buf)) {
+        fmt_flush();
+    }
+
+    return sink->buf + sink->len;
+}
+#endif
 
 void colla_init(colla_modules_e modules) {
     colla__initialised_modules = modules;
@@ -40,6 +75,8 @@ void colla_init(colla_modules_e modules) {
 }
 
 void colla_cleanup(void) {
+    fmt_flush();
+
     colla_modules_e modules = colla__initialised_modules;
     if (modules & COLLA_OS) {
         os_cleanup();
@@ -58,8 +95,58 @@ int fmt_print(const char *fmt, ...) {
 }
 
 int fmt_printv(const char *fmt, va_list args) {
-    char buffer[STB_SPRINTF_MIN] = {0};
-    return colla_stb_vsprintfcb(colla_fmt__stb_callback, buffer, buffer, fmt, args);
+#if COLLA_TCC
+    char buf[STB_SPRINTF_MIN];
+    int out = colla_stb_vsprintfcb(colla_fmt__stb_direct, buf, buf, fmt, args);
+    if (colla__fmt_policy != FMT_FLUSH_EXPLICIT) {
+        fflush(stdout);
+    }
+    return out;
+#else
+    colla_fmt_sink_t *sink = &colla__fmt_sink;
+    int out = colla_stb_vsprintfcb(colla_fmt__stb_callback, NULL, sink->buf + sink->len, fmt, args);
+
+    bool should_flush = false;
+    switch (colla__fmt_policy) {
+        case FMT_FLUSH_LINE:
+            should_flush = sink->has_newline;
+            break;
+        case FMT_FLUSH_SIZE:
+            should_flush = sink->len >= colla__fmt_flush_size;
+            break;
+        default:
+            break;
+    }
+
+    if (should_flush) {
+        fmt_flush();
+    }
+
+    return out;
+#endif
+}
+
+void fmt_set_flush_policy(fmt_flush_e policy, usize flush_size) {
+    fmt_flush();
+    if (flush_size == 0 || flush_size > COLLA_FMT_BUFFER_SIZE - STB_SPRINTF_MIN) {
+        flush_size = COLLA_FMT_BUFFER_SIZE - STB_SPRINTF_MIN;
+    }
+    colla__fmt_policy = policy;
+    colla__fmt_flush_size = flush_size;
+}
+
+void fmt_flush(void) {
+#if COLLA_TCC
+    fflush(stdout);
+#else
+    colla_fmt_sink_t *sink = &colla__fmt_sink;
+    if (sink->len) {
+        fwrite(sink->buf, 1, sink->len, stdout);
+        fflush(stdout);
+    }
+    sink->len = 0;
+    sink->has_newline = false;
+#endif
 }
 
 int fmt_buffer(char *buf, usize len, const char *fmt, ...) {
@@ -134,6 +134,42 @@ void colla_cleanup(void);
     #define alignof __alignof__
 #endif
 
+#if COLLA_MSVC
+    #define COLLA_THREAD_LOCAL __declspec(thread)
+#elif COLLA_TCC
+    // tcc doesn't support thread local storage
+    #define COLLA_THREAD_LOCAL
+#else
+    #define COLLA_THREAD_LOCAL __thread
+#endif
+
+// SIMD paths can be turned off by defining COLLA_NO_SIMD
+#if !COLLA_TCC && !defined(COLLA_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #define COLLA_SSE2 1
+#else
+    #define COLLA_SSE2 0
+#endif
+
+#if COLLA_SSE2 && (defined(__SSSE3__) || defined(__AVX__))
+    #define COLLA_SSSE3 1
+#else
+    #define COLLA_SSSE3 0
+#endif
+
+// cl only defines __AVX__ with /arch:AVX but lets any intrinsic be used, so
+// without it the SSSE3 paths are still compiled and picked at runtime with cpuid
+#if COLLA_MSVC && COLLA_SSE2 && !COLLA_SSSE3
+    #define COLLA_SSSE3_RUNTIME 1
+#else
+    #define COLLA_SSSE3_RUNTIME 0
+#endif
+
+#if !COLLA_TCC && !defined(COLLA_NO_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+    #define COLLA_NEON 1
+#else
+    #define COLLA_NEON 0
+#endif
+
 #if COLLA_WIN
     #undef  NOMINMAX
     #undef  WIN32_LEAN_AND_MEAN
@@ -189,6 +225,26 @@ typedef struct arena_t arena_t;
 
 // FORMATTING ///////////////////////////////////
 
+// fmt_print doesn't write to stdout directly, the output is first collected in
+// a per-thread buffer of COLLA_FMT_BUFFER_SIZE bytes and then written in one go.
+// threads started with os_thread_launch flush theirs when they exit. with tcc
+// (no thread locals) it goes through stdio's buffer instead, flushed after
+// every print unless the policy is FMT_FLUSH_EXPLICIT
+#ifndef COLLA_FMT_BUFFER_SIZE
+#define COLLA_FMT_BUFFER_SIZE (KB(8))
+#endif
+
+typedef enum {
+    FMT_FLUSH_LINE,     // default, flush whenever a new line is printed
+    FMT_FLUSH_SIZE,     // flush once the buffer holds at least flush_size bytes
+    FMT_FLUSH_EXPLICIT, // only flush on fmt_flush, or when the buffer is full
+} fmt_flush_e;
+
+// flush_size is only used by FMT_FLUSH_SIZE, 0 means the whole buffer
+void fmt_set_flush_policy(fmt_flush_e policy, usize flush_size);
+// writes out whatever the calling thread has buffered
+void fmt_flush(void);
+
 int fmt_print(const char *fmt, ...);
 int fmt_printv(const char *fmt, va_list args);
 int fmt_buffer(char *buf, usize len, const char *fmt, ...);
@@ -196,4 +252,286 @@ int fmt_bufferv(char *buf, usize len, const char *fmt, va_list args);
 
 /////////////////////////////////////////////////
 
+// ATOMICS //////////////////////////////////////
+
+// the values match gcc's __ATOMIC_* so they can be passed straight through
+typedef enum {
+    ATOMIC_RELAXED = 0,
+    ATOMIC_ACQUIRE = 2, // not valid for stores
+    ATOMIC_RELEASE = 3, // not valid for loads
+    ATOMIC_ACQ_REL = 4, // read-modify-write only
+    ATOMIC_SEQ_CST = 5,
+} atomic_order_e;
+
+// all read-modify-write functions return the previous value. atomic_cas_*
+// writes the value it found in expected when it fails. the *_ptr functions
+// take a pointer to the pointer, e.g. atomic_load_ptr((void **)&list, ...)
+//
+// msvc and tcc only have full barriers for read-modify-write operations,
+// so order is only really used for loads and stores there.
+// tcc is x86 only, and on 32 bit the u64 functions are not available
+
+#if COLLA_GCC || COLLA_CLANG
+
+#define COLLA__ATOMIC_FAIL_ORDER(o) \
+    ((o) == ATOMIC_ACQ_REL ? ATOMIC_ACQUIRE : (o) == ATOMIC_RELEASE ? ATOMIC_RELAXED : (o))
+
+#define COLLA__ATOMIC_FUNCS(T) \
+    static inline T atomic_load_##T(volatile T *p, atomic_order_e order) { return __atomic_load_n(p, order); } \
+    static inline void atomic_store_##T(volatile T *p, T value, atomic_order_e order) { __atomic_store_n(p, value, order); } \
+    static inline T atomic_exchange_##T(volatile T *p, T value, atomic_order_e order) { return __atomic_exchange_n(p, value, order); } \
+    static inline T atomic_add_##T(volatile T *p, T value, atomic_order_e order) { return __atomic_fetch_add(p, value, order); } \
+    static inline bool atomic_cas_##T(volatile T *p, T *expected, T desired, atomic_order_e order) { \
+        return __atomic_compare_exchange_n(p, expected, desired, false, order, COLLA__ATOMIC_FAIL_ORDER(order)); \
+    }
+
+COLLA__ATOMIC_FUNCS(u32)
+COLLA__ATOMIC_FUNCS(u64)
+
+static inline void *atomic_load_ptr(void *volatile *p, atomic_order_e order) {
+    return __atomic_load_n(p, order);
+}
+
+static inline void atomic_store_ptr(void *volatile *p, void *value, atomic_order_e order) {
+    __atomic_store_n(p, value, order);
+}
+
+static inline void *atomic_exchange_ptr(void *volatile *p, void *value, atomic_order_e order) {
+    return __atomic_exchange_n(p, value, order);
+}
+
+static inline bool atomic_cas_ptr(void *volatile *p, void **expected, void *desired, atomic_order_e order) {
+    return __atomic_compare_exchange_n(p, expected, desired, false, order, COLLA__ATOMIC_FAIL_ORDER(order));
+}
+
+static inline void atomic_fence(atomic_order_e order) {
+    __atomic_thread_fence(order);
+}
+
+static inline void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+#elif COLLA_MSVC
+
+#include <intrin.h>
+
+#if defined(_M_X64) || defined(_M_IX86)
+    // x86 loads are already acquire and stores release, only stop the compiler
+    #define COLLA__ATOMIC_BARRIER(o) _ReadWriteBarrier()
+#else
+    #define COLLA__ATOMIC_BARRIER(o) if ((o) != ATOMIC_RELAXED) __dmb(_ARM64_BARRIER_ISH)
+#endif
+
+static inline u32 atomic_load_u32(volatile u32 *p, atomic_order_e order) {
+    u32 value = *p;
+    COLLA__ATOMIC_BARRIER(order);
+    return value;
+}
+
+static inline void atomic_store_u32(volatile u32 *p, u32 value, atomic_order_e order) {
+    if (order == ATOMIC_SEQ_CST) {
+        _InterlockedExchange((volatile long *)p, (long)value);
+        return;
+    }
+    COLLA__ATOMIC_BARRIER(order);
+    *p = value;
+}
+
+static inline u32 atomic_exchange_u32(volatile u32 *p, u32 value, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    return (u32)_InterlockedExchange((volatile long *)p, (long)value);
+}
+
+static inline u32 atomic_add_u32(volatile u32 *p, u32 value, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    return (u32)_InterlockedExchangeAdd((volatile long *)p, (long)value);
+}
+
+static inline bool atomic_cas_u32(volatile u32 *p, u32 *expected, u32 desired, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    u32 prev = (u32)_InterlockedCompareExchange((volatile long *)p, (long)desired, (long)*expected);
+    bool success = prev == *expected;
+    *expected = prev;
+    return success;
+}
+
+static inline bool atomic_cas_u64(volatile u64 *p, u64 *expected, u64 desired, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    u64 prev = (u64)_InterlockedCompareExchange64((volatile __int64 *)p, (__int64)desired, (__int64)*expected);
+    bool success = prev == *expected;
+    *expected = prev;
+    return success;
+}
+
+#if defined(_M_IX86)
+
+// only the compare exchange is available for 64 bit values on x86
+static inline u64 atomic_load_u64(volatile u64 *p, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    return (u64)_InterlockedCompareExchange64((volatile __int64 *)p, 0, 0);
+}
+
+static inline u64 atomic_exchange_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    u64 prev = atomic_load_u64(p, ATOMIC_RELAXED);
+    while (!atomic_cas_u64(p, &prev, value, order));
+    return prev;
+}
+
+static inline void atomic_store_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    atomic_exchange_u64(p, value, order);
+}
+
+static inline u64 atomic_add_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    u64 prev = atomic_load_u64(p, ATOMIC_RELAXED);
+    while (!atomic_cas_u64(p, &prev, prev + value, order));
+    return prev;
+}
+
+#else
+
+static inline u64 atomic_load_u64(volatile u64 *p, atomic_order_e order) {
+    u64 value = *p;
+    COLLA__ATOMIC_BARRIER(order);
+    return value;
+}
+
+static inline void atomic_store_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    if (order == ATOMIC_SEQ_CST) {
+        _InterlockedExchange64((volatile __int64 *)p, (__int64)value);
+        return;
+    }
+    COLLA__ATOMIC_BARRIER(order);
+    *p = value;
+}
+
+static inline u64 atomic_exchange_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    return (u64)_InterlockedExchange64((volatile __int64 *)p, (__int64)value);
+}
+
+static inline u64 atomic_add_u64(volatile u64 *p, u64 value, atomic_order_e order) {
+    COLLA_UNUSED(order);
+    return (u64)_InterlockedExchangeAdd64((volatile __int64 *)p, (__int64)value);
+}
+
+#endif
+
+static inline void atomic_fence(atomic_order_e order) {
+    if (order == ATOMIC_SEQ_CST) {
+        // any locked instruction is a full barrier
+        volatile long dummy = 0;
+        _InterlockedExchange(&dummy, 1);
+        return;
+    }
+    COLLA__ATOMIC_BARRIER(order);
+}
+
+static inline void cpu_relax(void) {
+#if defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#else
+    __yield();
+#endif
+}
+
+#elif COLLA_TCC
+
+// tcc has no atomic builtins, but it does understand gcc style inline assembly.
+// on x86 plain loads and stores already have acquire and release semantics
+
+#define COLLA__ASM_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+#define COLLA__ATOMIC_FUNCS(T, suffix) \
+    static inline T atomic_load_##T(volatile T *p, atomic_order_e order) { \
+        COLLA_UNUSED(order); \
+        T value = *p; \
+        COLLA__ASM_BARRIER(); \
+        return value; \
+    } \
+    static inline T atomic_exchange_##T(volatile T *p, T value, atomic_order_e order) { \
+        COLLA_UNUSED(order); \
+        __asm__ __volatile__("xchg" suffix " %0, %1" : "+r"(value), "+m"(*p) :: "memory"); \
+        return value; \
+    } \
+    static inline void atomic_store_##T(volatile T *p, T value, atomic_order_e order) { \
+        if (order == ATOMIC_SEQ_CST) { \
+            atomic_exchange_##T(p, value, order); \
+            return; \
+        } \
+        COLLA__ASM_BARRIER(); \
+        *p = value; \
+    } \
+    static inline T atomic_add_##T(volatile T *p, T value, atomic_order_e order) { \
+        COLLA_UNUSED(order); \
+        __asm__ __volatile__("lock; xadd" suffix " %0, %1" : "+r"(value), "+m"(*p) :: "memory"); \
+        return value; \
+    } \
+    static inline bool atomic_cas_##T(volatile T *p, T *expected, T desired, atomic_order_e order) { \
+        COLLA_UNUSED(order); \
+        T prev; \
+        __asm__ __volatile__("lock; cmpxchg" suffix " %2, %1" : "=a"(prev), "+m"(*p) : "r"(desired), "0"(*expected) : "memory"); \
+        bool success = prev == *expected; \
+        *expected = prev; \
+        return success; \
+    }
+
+COLLA__ATOMIC_FUNCS(u32, "l")
+#if defined(__x86_64__)
+COLLA__ATOMIC_FUNCS(u64, "q")
+#endif
+
+static inline void atomic_fence(atomic_order_e order) {
+    if (order == ATOMIC_SEQ_CST) {
+        __asm__ __volatile__("mfence" ::: "memory");
+        return;
+    }
+    COLLA__ASM_BARRIER();
+}
+
+static inline void cpu_relax(void) {
+    __asm__ __volatile__("pause" ::: "memory");
+}
+
+#endif
+
+#if !COLLA_GCC && !COLLA_CLANG
+
+#if UINTPTR_MAX == UINT64_MAX
+    #define COLLA__ATOMIC_PTR_T u64
+    #define COLLA__ATOMIC_PTR(name) atomic_##name##_u64
+#else
+    #define COLLA__ATOMIC_PTR_T u32
+    #define COLLA__ATOMIC_PTR(name) atomic_##name##_u32
+#endif
+
+static inline void *atomic_load_ptr(void *volatile *p, atomic_order_e order) {
+    return (void *)(uptr)COLLA__ATOMIC_PTR(load)((volatile COLLA__ATOMIC_PTR_T *)p, order);
+}
+
+static inline void atomic_store_ptr(void *volatile *p, void *value, atomic_order_e order) {
+    COLLA__ATOMIC_PTR(store)((volatile COLLA__ATOMIC_PTR_T *)p, (COLLA__ATOMIC_PTR_T)(uptr)value, order);
+}
+
+static inline void *atomic_exchange_ptr(void *volatile *p, void *value, atomic_order_e order) {
+    return (void *)(uptr)COLLA__ATOMIC_PTR(exchange)((volatile COLLA__ATOMIC_PTR_T *)p, (COLLA__ATOMIC_PTR_T)(uptr)value, order);
+}
+
+static inline bool atomic_cas_ptr(void *volatile *p, void **expected, void *desired, atomic_order_e order) {
+    COLLA__ATOMIC_PTR_T prev = (COLLA__ATOMIC_PTR_T)(uptr)*expected;
+    bool success = COLLA__ATOMIC_PTR(cas)((volatile COLLA__ATOMIC_PTR_T *)p, &prev, (COLLA__ATOMIC_PTR_T)(uptr)desired, order);
+    *expected = (void *)(uptr)prev;
+    return success;
+}
+
+#endif
+
+/////////////////////////////////////////////////
+
 #endif
\ No newline at end of file
@@ -0,0 +1,433 @@
+#include "jobs.h"
+#include "os.h"
+
+#include <string.h>
+
+// auto-reset events implemented by the os module
+oshandle_t os__event_create(void);
+void os__event_signal(oshandle_t event);
+void os__event_free(oshandle_t event);
+
+#define JOBS__DEFAULT_QUEUE_SIZE (4096)
+#define JOBS__DEFAULT_SCRATCH    (GB(1))
+// how long an idle worker sleeps before looking for work again
+#define JOBS__IDLE_TIMEOUT_MS    (10)
+
+typedef struct jobs__entry_t jobs__entry_t;
+struct jobs__entry_t {
+    job_t job;
+    job_counter_t *counter;
+};
+
+// Chase-Lev deque: the owner pushes and takes from the bottom, every other
+// thread steals from the top. the size is fixed, a full deque just fails.
+// top and bottom are allowed to wrap around
+typedef struct jobs__deque_t jobs__deque_t;
+struct jobs__deque_t {
+    volatile u32 top;
+    u8 pad[64];
+    volatile u32 bottom;
+    jobs__entry_t *items;
+    u32 mask;
+};
+
+typedef struct jobs__worker_t jobs__worker_t;
+struct jobs__worker_t {
+    jobs__deque_t deque;
+    arena_t scratch;
+    oshandle_t thread;
+    u32 index;
+    u8 pad[64];
+};
+
+struct {
+    arena_t arena;
+    jobs__worker_t *workers;
+    u32 worker_count;
+    usize scratch_size;
+    // jobs pushed from threads that are not workers
+    oshandle_t inject_lock;
+    jobs__entry_t *inject;
+    u32 inject_head;
+    u32 inject_count;
+    u32 inject_mask;
+    volatile u32 inject_len;
+    oshandle_t wake_event; // idle workers sleep on this
+    oshandle_t done_event; // threads in jobs_wait sleep on this
+    volatile u32 sleeping;
+    volatile u32 waiting;
+    volatile u32 running;
+    // jobs that haven't finished, including the ones running right now
+    volatile u32 pending;
+    // jobs sitting in a queue that nobody picked up yet, workers only go to
+    // sleep when this is 0
+    volatile u32 queued;
+} jobs__data = {0};
+
+static COLLA_THREAD_LOCAL jobs__worker_t *jobs__current = NULL;
+static COLLA_THREAD_LOCAL u32 jobs__rng = 0;
+
+bool jobs__deque_push(jobs__deque_t *dq, jobs__entry_t *entry) {
+    u32 b = atomic_load_u32(&dq->bottom, ATOMIC_SEQ_CST);
+    u32 t = atomic_load_u32(&dq->top, ATOMIC_SEQ_CST);
+    if ((b - t) > dq->mask) {
+        return false;
+    }
+    dq->items[b & dq->mask] = *entry;
+    atomic_store_u32(&dq->bottom, b + 1, ATOMIC_SEQ_CST);
+    return true;
+}
+
+bool jobs__deque_take(jobs__deque_t *dq, jobs__entry_t *out) {
+    u32 b = atomic_load_u32(&dq->bottom, ATOMIC_SEQ_CST) - 1;
+    atomic_store_u32(&dq->bottom, b, ATOMIC_SEQ_CST);
+    u32 t = atomic_load_u32(&dq->top, ATOMIC_SEQ_CST);
+
+    i32 size = (i32)(b - t);
+    if (size < 0) {
+        atomic_store_u32(&dq->bottom, b + 1, ATOMIC_SEQ_CST);
+        return false;
+    }
+
+    *out = dq->items[b & dq->mask];
+    if (size > 0) {
+        return true;
+    }
+
+    // this was the last job, a thief might be taking it right now
+    bool won = atomic_cas_u32(&dq->top, &t, t + 1, ATOMIC_SEQ_CST);
+    atomic_store_u32(&dq->bottom, b + 1, ATOMIC_SEQ_CST);
+    return won;
+}
+
+bool jobs__deque_steal(jobs__deque_t *dq, jobs__entry_t *out) {
+    u32 t = atomic_load_u32(&dq->top, ATOMIC_SEQ_CST);
+    u32 b = atomic_load_u32(&dq->bottom, ATOMIC_SEQ_CST);
+    if ((i32)(b - t) <= 0) {
+        return false;
+    }
+
+    // copy it before the cas, after that the owner may reuse the slot. if the
+    // owner already wrapped around and overwrote it the cas fails and the copy
+    // is thrown away
+    jobs__entry_t entry = dq->items[t & dq->mask];
+    if (!atomic_cas_u32(&dq->top, &t, t + 1, ATOMIC_SEQ_CST)) {
+        return false;
+    }
+
+    *out = entry;
+    return true;
+}
+
+bool jobs__inject_push(jobs__entry_t *entry) {
+    bool pushed = false;
+    os_mutex_lock(jobs__data.inject_lock);
+    if (jobs__data.inject_count <= jobs__data.inject_mask) {
+        u32 index = (jobs__data.inject_head + jobs__data.inject_count) & jobs__data.inject_mask;
+        jobs__data.inject[index] = *entry;
+        jobs__data.inject_count++;
+        atomic_store_u32(&jobs__data.inject_len, jobs__data.inject_count, ATOMIC_RELAXED);
+        pushed = true;
+    }
+    os_mutex_unlock(jobs__data.inject_lock);
+    return pushed;
+}
+
+bool jobs__inject_pop(jobs__entry_t *out) {
+    // cheap check first, so workers don't fight over the lock for nothing
+    if (atomic_load_u32(&jobs__data.inject_len, ATOMIC_RELAXED) == 0) {
+        return false;
+    }
+
+    bool popped = false;
+    os_mutex_lock(jobs__data.inject_lock);
+    if (jobs__data.inject_count) {
+        *out = jobs__data.inject[jobs__data.inject_head];
+        jobs__data.inject_head = (jobs__data.inject_head + 1) & jobs__data.inject_mask;
+        jobs__data.inject_count--;
+        atomic_store_u32(&jobs__data.inject_len, jobs__data.inject_count, ATOMIC_RELAXED);
+        popped = true;
+    }
+    os_mutex_unlock(jobs__data.inject_lock);
+    return popped;
+}
+
+u32 jobs__next_random(void) {
+    // xorshift, only used to pick who to steal from
+    u32 x = jobs__rng ? jobs__rng : (u32)(uptr)&jobs__rng | 1;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    jobs__rng = x;
+    return x;
+}
+
+bool jobs__find_any(jobs__worker_t *self, jobs__entry_t *out) {
+    if (self && jobs__deque_take(&self->deque, out)) {
+        return true;
+    }
+
+    if (jobs__inject_pop(out)) {
+        return true;
+    }
+
+    u32 count = jobs__data.worker_count;
+    u32 start = jobs__next_random() % count;
+    for (u32 i = 0; i < count; ++i) {
+        jobs__worker_t *victim = &jobs__data.workers[(start + i) % count];
+        if (victim != self && jobs__deque_steal(&victim->deque, out)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool jobs__find(jobs__worker_t *self, jobs__entry_t *out) {
+    if (!jobs__find_any(self, out)) {
+        return false;
+    }
+    atomic_add_u32(&jobs__data.queued, (u32)-1, ATOMIC_SEQ_CST);
+    return true;
+}
+
+void jobs__execute(arena_t *scratch, jobs__entry_t *entry) {
+    // nested jobs (from jobs_wait inside of a job) allocate after the outer
+    // job, everything is popped once the job returns
+    arena_t before = *scratch;
+    entry->job.func(scratch, entry->job.userdata);
+    *scratch = before;
+
+    if (entry->counter) {
+        atomic_add_u32(&entry->counter->value, (u32)-1, ATOMIC_ACQ_REL);
+    }
+    atomic_add_u32(&jobs__data.pending, (u32)-1, ATOMIC_ACQ_REL);
+
+    if (atomic_load_u32(&jobs__data.waiting, ATOMIC_SEQ_CST) > 0) {
+        os__event_signal(jobs__data.done_event);
+    }
+}
+
+void jobs__wake_worker(void) {
+    if (atomic_load_u32(&jobs__data.sleeping, ATOMIC_SEQ_CST) > 0) {
+        os__event_signal(jobs__data.wake_event);
+    }
+}
+
+int jobs__worker_main(u64 thread_id, void *userdata) {
+    COLLA_UNUSED(thread_id);
+
+    jobs__worker_t *self = userdata;
+    jobs__current = self;
+    jobs__rng = self->index * 2654435761u + 1;
+
+    while (atomic_load_u32(&jobs__data.running, ATOMIC_ACQUIRE)) {
+        jobs__entry_t entry = {0};
+        if (jobs__find(self, &entry)) {
+            // there might be more work than awake workers
+            jobs__wake_worker();
+            jobs__execute(&self->scratch, &entry);
+            continue;
+        }
+
+        // jobs that are still running don't count, there is nothing to steal
+        // from them. pushing bumps queued before it checks sleeping, so either
+        // we see the job here or the pusher sees us and signals the event
+        atomic_add_u32(&jobs__data.sleeping, 1, ATOMIC_SEQ_CST);
+        if (atomic_load_u32(&jobs__data.queued, ATOMIC_SEQ_CST) == 0) {
+            os_wait_on_handles(&jobs__data.wake_event, 1, false, JOBS__IDLE_TIMEOUT_MS);
+        }
+        atomic_add_u32(&jobs__data.sleeping, (u32)-1, ATOMIC_RELAXED);
+    }
+
+    jobs__current = NULL;
+    return 0;
+}
+
+// stops the workers that were started and frees everything, there must not
+// be any jobs left
+void jobs__stop(void) {
+    atomic_store_u32(&jobs__data.running, 0, ATOMIC_RELEASE);
+
+    for (u32 i = 0; i < jobs__data.worker_count; ++i) {
+        os__event_signal(jobs__data.wake_event);
+    }
+
+    for (u32 i = 0; i < jobs__data.worker_count; ++i) {
+        jobs__worker_t *worker = &jobs__data.workers[i];
+        os_thread_join(worker->thread, NULL);
+        arena_cleanup(&worker->scratch);
+    }
+
+    os_mutex_free(jobs__data.inject_lock);
+    os__event_free(jobs__data.wake_event);
+    os__event_free(jobs__data.done_event);
+    arena_cleanup(&jobs__data.arena);
+
+    memset(&jobs__data, 0, sizeof(jobs__data));
+}
+
+bool jobs_init(const jobs_desc_t *desc) {
+#if COLLA_TCC
+    COLLA_UNUSED(desc);
+    err("the job system needs thread local storage, which tcc doesn't support");
+    return false;
+#else
+    if (atomic_load_u32(&jobs__data.running, ATOMIC_ACQUIRE)) {
+        err("the job system has already been started");
+        return false;
+    }
+
+    jobs_desc_t opts = desc ? *desc : (jobs_desc_t){0};
+
+    u32 worker_count = opts.worker_count ? opts.worker_count : os_get_system_info().processor_count;
+    worker_count = MAX(worker_count, 1);
+
+    u32 queue_size = 1;
+    u32 wanted = opts.queue_size ? opts.queue_size : JOBS__DEFAULT_QUEUE_SIZE;
+    while (queue_size < wanted) {
+        queue_size <<= 1;
+    }
+
+    jobs__data.scratch_size = opts.scratch_size ? opts.scratch_size : JOBS__DEFAULT_SCRATCH;
+
+    usize memory = sizeof(jobs__worker_t) * worker_count + sizeof(jobs__entry_t) * queue_size * (worker_count + 1);
+    jobs__data.arena = arena_make(ARENA_MALLOC, memory + KB(4));
+
+    jobs__data.workers = alloc(&jobs__data.arena, jobs__worker_t, worker_count);
+    jobs__data.worker_count = worker_count;
+
+    jobs__data.inject = alloc(&jobs__data.arena, jobs__entry_t, queue_size, ALLOC_NOZERO);
+    jobs__data.inject_mask = queue_size - 1;
+    jobs__data.inject_lock = os_mutex_create();
+
+    jobs__data.wake_event = os__event_create();
+    jobs__data.done_event = os__event_create();
+
+    atomic_store_u32(&jobs__data.running, 1, ATOMIC_RELEASE);
+
+    for (u32 i = 0; i < worker_count; ++i) {
+        jobs__worker_t *worker = &jobs__data.workers[i];
+        worker->index = i;
+        worker->deque.items = alloc(&jobs__data.arena, jobs__entry_t, queue_size, ALLOC_NOZERO);
+        worker->deque.mask = queue_size - 1;
+        worker->scratch = arena_make(ARENA_VIRTUAL, jobs__data.scratch_size);
+    }
+
+    // only start the threads once every deque exists, they steal from each other
+    for (u32 i = 0; i < worker_count; ++i) {
+        jobs__worker_t *worker = &jobs__data.workers[i];
+        worker->thread = os_thread_launch(jobs__worker_main, worker);
+        if (!os_handle_valid(worker->thread)) {
+            err("couldn't launch job worker %u", i);
+            jobs__stop();
+            return false;
+        }
+    }
+
+    return true;
+#endif
+}
+
+void jobs_cleanup(void) {
+    if (!atomic_load_u32(&jobs__data.running, ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    // help out until every job has finished, like jobs_wait does
+    while (atomic_load_u32(&jobs__data.pending, ATOMIC_ACQUIRE) > 0) {
+        jobs__entry_t entry = {0};
+        if (jobs__find(jobs__current, &entry)) {
+            arena_t scratch = arena_make(ARENA_VIRTUAL, jobs__data.scratch_size);
+            jobs__execute(&scratch, &entry);
+            arena_cleanup(&scratch);
+        }
+        else {
+            atomic_add_u32(&jobs__data.waiting, 1, ATOMIC_SEQ_CST);
+            os_wait_on_handles(&jobs__data.done_event, 1, false, 1);
+            atomic_add_u32(&jobs__data.waiting, (u32)-1, ATOMIC_RELAXED);
+        }
+    }
+
+    jobs__stop();
+}
+
+void jobs_run(job_t *jobs, usize count, job_counter_t *counter) {
+    if (counter) {
+        atomic_add_u32(&counter->value, (u32)count, ATOMIC_RELAXED);
+    }
+    atomic_add_u32(&jobs__data.pending, (u32)count, ATOMIC_SEQ_CST);
+
+    jobs__worker_t *self = jobs__current;
+
+    for (usize i = 0; i < count; ++i) {
+        jobs__entry_t entry = {
+            .job = jobs[i],
+            .counter = counter,
+        };
+
+        // counted before the push, so a thief can never take it below zero
+        atomic_add_u32(&jobs__data.queued, 1, ATOMIC_SEQ_CST);
+
+        bool pushed = self ?
+            jobs__deque_push(&self->deque, &entry) :
+            jobs__inject_push(&entry);
+
+        if (pushed) {
+            jobs__wake_worker();
+            continue;
+        }
+
+        atomic_add_u32(&jobs__data.queued, (u32)-1, ATOMIC_SEQ_CST);
+
+        // the queue is full, might as well do the work here
+        if (self) {
+            jobs__execute(&self->scratch, &entry);
+        }
+        else {
+            arena_t scratch = arena_make(ARENA_VIRTUAL, jobs__data.scratch_size);
+            jobs__execute(&scratch, &entry);
+            arena_cleanup(&scratch);
+        }
+    }
+}
+
+void jobs_wait(job_counter_t *counter) {
+    if (!counter) {
+        return;
+    }
+
+    jobs__worker_t *self = jobs__current;
+    // threads outside of the pool only get a scratch arena if they end up running a job
+    arena_t local = {0};
+    arena_t *scratch = self ? &self->scratch : NULL;
+
+    while (atomic_load_u32(&counter->value, ATOMIC_ACQUIRE) > 0) {
+        jobs__entry_t entry = {0};
+        if (jobs__find(self, &entry)) {
+            if (!scratch) {
+                local = arena_make(ARENA_VIRTUAL, jobs__data.scratch_size);
+                scratch = &local;
+            }
+            jobs__execute(scratch, &entry);
+            continue;
+        }
+
+        // the remaining jobs are running on other threads
+        atomic_add_u32(&jobs__data.waiting, 1, ATOMIC_SEQ_CST);
+        if (atomic_load_u32(&counter->value, ATOMIC_ACQUIRE) > 0) {
+            os_wait_on_handles(&jobs__data.done_event, 1, false, 1);
+        }
+        atomic_add_u32(&jobs__data.waiting, (u32)-1, ATOMIC_RELAXED);
+    }
+
+    arena_cleanup(&local);
+}
+
+u32 jobs_worker_count(void) {
+    return jobs__data.worker_count;
+}
+
+int jobs_worker_index(void) {
+    return jobs__current ? (int)jobs__current->index : -1;
+}
@@ -0,0 +1,50 @@
+#ifndef COLLA_JOBS_H
+#define COLLA_JOBS_H
+
+#include "core.h"
+#include "arena.h"
+
+// fixed pool of workers, each one with its own work-stealing deque. jobs
+// pushed from a worker (e.g. children of a running job) go in its deque,
+// jobs pushed from any other thread go in a shared queue
+
+// the arena is a per-worker scratch arena, it is reset after the job returns
+typedef void (job_func_t)(arena_t *scratch, void *userdata);
+
+typedef struct job_t job_t;
+struct job_t {
+    job_func_t *func;
+    void *userdata;
+};
+
+// number of jobs still running, zero initialise it before use
+typedef struct job_counter_t job_counter_t;
+struct job_counter_t {
+    volatile u32 value;
+};
+
+typedef struct jobs_desc_t jobs_desc_t;
+struct jobs_desc_t {
+    u32 worker_count;  // defaults to os_get_system_info().processor_count
+    u32 queue_size;    // jobs per queue, rounded up to a power of 2, defaults to 4096
+    usize scratch_size; // size of the scratch arenas, defaults to GB(1) of virtual memory
+};
+
+// [ u32 worker_count, u32 queue_size, usize scratch_size ]
+#define jobs_make(...) jobs_init(&(jobs_desc_t){ __VA_ARGS__ })
+
+bool jobs_init(const jobs_desc_t *desc);
+// waits for every job to finish before stopping the workers
+void jobs_cleanup(void);
+
+// pushes the jobs and adds count to counter (which can be NULL), each finished
+// job decrements it. if a queue is full the job is run right away
+void jobs_run(job_t *jobs, usize count, job_counter_t *counter);
+// runs other jobs until the counter reaches zero, callable from any thread
+void jobs_wait(job_counter_t *counter);
+
+u32 jobs_worker_count(void);
+// index of the calling worker, or -1 if this is not a worker thread
+int jobs_worker_index(void);
+
+#endif
@@ -0,0 +1,501 @@
+#include "metrics.h"
+#include "os.h"
+
+#include <math.h>
+#include <string.h>
+
+#define METRICS__DEFAULT_SLOTS (16384)
+#define METRICS__HISTOGRAM_SLOTS (METRICS_HISTOGRAM_BUCKETS + 1)
+
+typedef struct metrics__shard_t metrics__shard_t;
+struct metrics__shard_t {
+    metrics__shard_t *next;
+    usize alloc_size;
+    volatile u64 slots[];
+};
+
+typedef struct metrics__local_t metrics__local_t;
+struct metrics__local_t {
+    metrics__shard_t *shard;
+    // the shard is only valid for the metrics_init it was made in
+    u32 generation;
+};
+
+// there are two locks as allocating from the registry arena can commit
+// memory, which records into a shard and might have to make one
+struct {
+    bool initialised;
+    u32 generation;
+    u32 max_slots;
+    u32 next_slot;
+    arena_t arena;
+    os_lock_t registry_lock;
+    metric_t *metrics;
+    metric_t *tail;
+    os_lock_t shards_lock;
+    metrics__shard_t *shards;
+    // what threads recorded before exiting is added up in here (it's the
+    // shard of the first thread that exited), their shards are then reused
+    metrics__shard_t *retired;
+    metrics__shard_t *free_shards;
+} metrics__data = {0};
+
+static COLLA_THREAD_LOCAL metrics__local_t metrics__local = {0};
+
+metrics_colla_t metrics_colla = {0};
+
+static inline u32 metrics__msb(u64 value) {
+#if COLLA_MSVC && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return (u32)index;
+#elif COLLA_GCC || COLLA_CLANG
+    return 63 - (u32)__builtin_clzll(value);
+#else
+    u32 index = 0;
+    while (value >>= 1) {
+        index++;
+    }
+    return index;
+#endif
+}
+
+u32 metrics_bucket_index(u64 value) {
+    if (value < METRICS_SUB_BUCKETS) {
+        return (u32)value;
+    }
+    u32 shift = metrics__msb(value) - METRICS_SUB_BUCKET_BITS;
+    return ((shift + 1) << METRICS_SUB_BUCKET_BITS) + (u32)((value >> shift) & (METRICS_SUB_BUCKETS - 1));
+}
+
+u64 metrics_bucket_lower(u32 index) {
+    if (index < METRICS_SUB_BUCKETS) {
+        return index;
+    }
+    u32 shift = (index >> METRICS_SUB_BUCKET_BITS) - 1;
+    return (u64)(METRICS_SUB_BUCKETS + (index & (METRICS_SUB_BUCKETS - 1))) << shift;
+}
+
+u64 metrics__bucket_upper(u32 index) {
+    if ((index + 1) >= METRICS_HISTOGRAM_BUCKETS) {
+        return UINT64_MAX;
+    }
+    return metrics_bucket_lower(index + 1) - 1;
+}
+
+bool metrics_init(const metrics_desc_t *desc) {
+    if (metrics__data.initialised) {
+        warn("metrics already initialised");
+        return true;
+    }
+
+    metrics__data.max_slots = desc && desc->max_slots ? desc->max_slots : METRICS__DEFAULT_SLOTS;
+    metrics__data.next_slot = 0;
+    metrics__data.arena = arena_make(ARENA_VIRTUAL, MB(64));
+    metrics__data.generation++;
+    metrics__data.initialised = true;
+
+    metrics_colla = (metrics_colla_t){
+        .arena_commits         = metrics_counter(strv("colla_arena_commits_total"), strv("Number of times a virtual arena committed more memory")),
+        .arena_commit_bytes    = metrics_counter(strv("colla_arena_commit_bytes_total"), strv("Bytes passed to os_commit by virtual arenas, pages already committed are counted again")),
+        .net_sent_bytes        = metrics_counter(strv("colla_net_sent_bytes_total"), strv("Bytes sent with sk_send and http_request")),
+        .net_received_bytes    = metrics_counter(strv("colla_net_received_bytes_total"), strv("Bytes received with sk_recv and http_request")),
+        .http_requests         = metrics_counter(strv("colla_http_requests_total"), strv("Number of http_request calls")),
+        .http_failures         = metrics_counter(strv("colla_http_failures_total"), strv("Number of http_request calls that failed")),
+        .http_duration_ns      = metrics_histogram(strv("colla_http_request_duration_nanoseconds"), strv("Time taken by http_request")),
+    };
+
+    return true;
+}
+
+void metrics_cleanup(void) {
+    if (!metrics__data.initialised) {
+        return;
+    }
+
+    metrics_colla = (metrics_colla_t){0};
+
+    os_lock_acquire(&metrics__data.shards_lock);
+    metrics__shard_t *lists[] = { metrics__data.shards, metrics__data.free_shards };
+    for (int i = 0; i < arrlen(lists); ++i) {
+        metrics__shard_t *shard = lists[i];
+        while (shard) {
+            metrics__shard_t *next = shard->next;
+            os_release(shard, shard->alloc_size);
+            shard = next;
+        }
+    }
+    metrics__data.shards = NULL;
+    metrics__data.retired = NULL;
+    metrics__data.free_shards = NULL;
+    metrics__data.generation++;
+    os_lock_release(&metrics__data.shards_lock);
+
+    os_lock_acquire(&metrics__data.registry_lock);
+    arena_cleanup(&metrics__data.arena);
+    metrics__data.metrics = NULL;
+    metrics__data.tail = NULL;
+    metrics__data.initialised = false;
+    os_lock_release(&metrics__data.registry_lock);
+}
+
+metric_t *metrics__register(strview_t name, strview_t help, metric_type_e type) {
+    if (!metrics__data.initialised) {
+        err("metrics_init has not been called");
+        return NULL;
+    }
+
+    metric_t *metric = NULL;
+
+    os_lock_acquire(&metrics__data.registry_lock);
+
+    for_each (it, metrics__data.metrics) {
+        if (strv_equals(strv(it->name), name)) {
+            metric = it;
+            break;
+        }
+    }
+
+    if (metric) {
+        if (metric->type != type) {
+            err("metric %v was already registered with a different type", name);
+            metric = NULL;
+        }
+        goto done;
+    }
+
+    u32 slots = 0;
+    switch (type) {
+        case METRIC_COUNTER:   slots = 1; break;
+        case METRIC_HISTOGRAM: slots = METRICS__HISTOGRAM_SLOTS; break;
+        default: break;
+    }
+
+    if ((metrics__data.next_slot + slots) > metrics__data.max_slots) {
+        err("no space left for metric %v, increase metrics_desc_t.max_slots", name);
+        goto done;
+    }
+
+    metric = alloc(&metrics__data.arena, metric_t);
+    metric->name = str(&metrics__data.arena, name);
+    metric->help = str(&metrics__data.arena, help);
+    metric->type = type;
+    metric->slot = metrics__data.next_slot;
+    metrics__data.next_slot += slots;
+
+    if (metrics__data.tail) metrics__data.tail->next = metric;
+    else                    metrics__data.metrics = metric;
+    metrics__data.tail = metric;
+
+done:
+    os_lock_release(&metrics__data.registry_lock);
+    return metric;
+}
+
+metric_t *metrics_counter(strview_t name, strview_t help) {
+    return metrics__register(name, help, METRIC_COUNTER);
+}
+
+metric_t *metrics_gauge(strview_t name, strview_t help) {
+    return metrics__register(name, help, METRIC_GAUGE);
+}
+
+metric_t *metrics_histogram(strview_t name, strview_t help) {
+    return metrics__register(name, help, METRIC_HISTOGRAM);
+}
+
+// shards don't come from an arena: arena commits are recorded in them
+metrics__shard_t *metrics__make_shard(void) {
+    os_lock_acquire(&metrics__data.shards_lock);
+    metrics__shard_t *shard = metrics__data.free_shards;
+    if (shard) {
+        list_pop(metrics__data.free_shards);
+    }
+    os_lock_release(&metrics__data.shards_lock);
+
+    if (!shard) {
+        usize size = sizeof(metrics__shard_t) + (usize)metrics__data.max_slots * sizeof(u64);
+
+        usize alloc_size = 0;
+        u8 *mem = os_reserve(size, &alloc_size);
+        if (!mem || !os_commit(mem, alloc_size / os_get_system_info().page_size)) {
+            err("couldn't allocate %zu bytes for the metrics shard", size);
+            if (mem) os_release(mem, alloc_size);
+            return NULL;
+        }
+
+        shard = (metrics__shard_t *)mem;
+        memset(shard, 0, size);
+        shard->alloc_size = alloc_size;
+    }
+
+    os_lock_acquire(&metrics__data.shards_lock);
+    shard->next = metrics__data.shards;
+    metrics__data.shards = shard;
+    metrics__local.generation = metrics__data.generation;
+    os_lock_release(&metrics__data.shards_lock);
+
+    metrics__local.shard = shard;
+    return shard;
+}
+
+// called by every thread launched with os_thread_launch before it exits. the
+// values are moved to the retired shard so they still show up in snapshots,
+// and the shard is kept around for the next thread
+void metrics__thread_exit(void) {
+#if !COLLA_TCC
+    metrics__shard_t *shard = metrics__local.shard;
+    if (!shard || metrics__local.generation != metrics__data.generation) {
+        return;
+    }
+
+    os_lock_acquire(&metrics__data.shards_lock);
+
+    // the generation can only change with the lock held
+    if (metrics__local.generation == metrics__data.generation) {
+        if (!metrics__data.retired) {
+            // nobody else writes to it, it can be the retired shard as it is
+            metrics__data.retired = shard;
+        }
+        else {
+            metrics__shard_t *retired = metrics__data.retired;
+            for (u32 i = 0; i < metrics__data.max_slots; ++i) {
+                if (shard->slots[i]) {
+                    atomic_store_u64(&retired->slots[i], retired->slots[i] + shard->slots[i], ATOMIC_RELAXED);
+                }
+            }
+
+            metrics__shard_t **it = &metrics__data.shards;
+            while (*it != shard) {
+                it = &(*it)->next;
+            }
+            *it = shard->next;
+
+            memset((void *)shard->slots, 0, (usize)metrics__data.max_slots * sizeof(u64));
+            list_push(metrics__data.free_shards, shard);
+        }
+    }
+
+    os_lock_release(&metrics__data.shards_lock);
+
+    metrics__local = (metrics__local_t){0};
+#endif
+}
+
+static inline metrics__shard_t *metrics__get_shard(void) {
+    if (metrics__local.shard && metrics__local.generation == metrics__data.generation) {
+        return metrics__local.shard;
+    }
+    return metrics__make_shard();
+}
+
+static inline void metrics__slot_add(volatile u64 *slot, u64 amount) {
+#if COLLA_TCC
+    // no thread locals, every thread shares the same shard
+    atomic_add_u64(slot, amount, ATOMIC_RELAXED);
+#else
+    // only this thread writes to it, the atomic store is for the snapshots
+    atomic_store_u64(slot, *slot + amount, ATOMIC_RELAXED);
+#endif
+}
+
+void metrics_add(metric_t *counter, u64 amount) {
+    if (!counter) {
+        return;
+    }
+    metrics__shard_t *shard = metrics__get_shard();
+    if (shard) {
+        metrics__slot_add(&shard->slots[counter->slot], amount);
+    }
+}
+
+void metrics_gauge_set(metric_t *gauge, i64 value) {
+    if (gauge) {
+        atomic_store_u64(&gauge->gauge, (u64)value, ATOMIC_RELAXED);
+    }
+}
+
+void metrics_gauge_add(metric_t *gauge, i64 amount) {
+    if (gauge) {
+        atomic_add_u64(&gauge->gauge, (u64)amount, ATOMIC_RELAXED);
+    }
+}
+
+void metrics_record(metric_t *histogram, u64 value) {
+    if (!histogram) {
+        return;
+    }
+    metrics__shard_t *shard = metrics__get_shard();
+    if (shard) {
+        volatile u64 *slots = &shard->slots[histogram->slot];
+        metrics__slot_add(&slots[metrics_bucket_index(value)], 1);
+        metrics__slot_add(&slots[METRICS_HISTOGRAM_BUCKETS], value);
+    }
+}
+
+void metrics__append(metrics_snapshot_t *snapshot, metric_value_t *value) {
+    if (snapshot->tail) snapshot->tail->next = value;
+    else                snapshot->head = value;
+    snapshot->tail = value;
+}
+
+metrics_snapshot_t metrics_snapshot(arena_t *arena) {
+    metrics_snapshot_t snapshot = {0};
+
+    if (!metrics__data.initialised) {
+        return snapshot;
+    }
+
+    os_lock_acquire(&metrics__data.registry_lock);
+
+    // allocate everything first, growing the arena could need the shards lock
+    for_each (metric, metrics__data.metrics) {
+        metric_value_t *value = alloc(arena, metric_value_t);
+        value->name = metric->name;
+        value->help = metric->help;
+        value->type = metric->type;
+        if (metric->type == METRIC_HISTOGRAM) {
+            value->buckets = alloc(arena, u64, METRICS_HISTOGRAM_BUCKETS);
+        }
+        metrics__append(&snapshot, value);
+    }
+
+    os_lock_acquire(&metrics__data.shards_lock);
+
+    metric_value_t *value = snapshot.head;
+    for_each (metric, metrics__data.metrics) {
+        switch (metric->type) {
+            case METRIC_COUNTER:
+                for_each (shard, metrics__data.shards) {
+                    value->value += atomic_load_u64(&shard->slots[metric->slot], ATOMIC_RELAXED);
+                }
+                break;
+
+            case METRIC_GAUGE:
+                value->gauge = (i64)atomic_load_u64(&metric->gauge, ATOMIC_RELAXED);
+                break;
+
+            case METRIC_HISTOGRAM:
+                for_each (shard, metrics__data.shards) {
+                    volatile u64 *slots = &shard->slots[metric->slot];
+                    for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+                        u64 count = atomic_load_u64(&slots[i], ATOMIC_RELAXED);
+                        value->buckets[i] += count;
+                        value->value += count;
+                    }
+                    value->sum += atomic_load_u64(&slots[METRICS_HISTOGRAM_BUCKETS], ATOMIC_RELAXED);
+                }
+                break;
+        }
+        value = value->next;
+    }
+
+    os_lock_release(&metrics__data.shards_lock);
+    os_lock_release(&metrics__data.registry_lock);
+
+    return snapshot;
+}
+
+metric_value_t *metrics_find(metrics_snapshot_t *snapshot, strview_t name) {
+    for_each (value, snapshot->head) {
+        if (strv_equals(strv(value->name), name)) {
+            return value;
+        }
+    }
+    return NULL;
+}
+
+void metrics_merge(arena_t *arena, metrics_snapshot_t *dst, metrics_snapshot_t *src) {
+    for_each (from, src->head) {
+        metric_value_t *to = metrics_find(dst, strv(from->name));
+
+        if (!to) {
+            to = alloc(arena, metric_value_t);
+            to->name = str(arena, strv(from->name));
+            to->help = str(arena, strv(from->help));
+            to->type = from->type;
+            if (from->type == METRIC_HISTOGRAM) {
+                to->buckets = alloc(arena, u64, METRICS_HISTOGRAM_BUCKETS);
+            }
+            metrics__append(dst, to);
+        }
+        else if (to->type != from->type) {
+            warn("metric %v has different types in the two snapshots, skipping it", from->name);
+            continue;
+        }
+
+        to->value += from->value;
+        to->gauge += from->gauge;
+        to->sum += from->sum;
+        if (from->type == METRIC_HISTOGRAM) {
+            for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+                to->buckets[i] += from->buckets[i];
+            }
+        }
+    }
+}
+
+u64 metrics_percentile(const metric_value_t *histogram, double percentile) {
+    if (!histogram || histogram->type != METRIC_HISTOGRAM || !histogram->value) {
+        return 0;
+    }
+
+    percentile = MIN(MAX(percentile, 0.0), 100.0);
+    u64 target = (u64)ceil(percentile / 100.0 * (double)histogram->value);
+    target = MAX(target, 1);
+
+    u64 seen = 0;
+    for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            return metrics__bucket_upper(i);
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+str_t metrics_to_prometheus(arena_t *arena, metrics_snapshot_t *snapshot) {
+    outstream_t out = ostr_init(arena);
+
+    for_each (value, snapshot->head) {
+        if (value->help.len) {
+            ostr_print(&out, "# HELP %v %v\n", value->name, value->help);
+        }
+
+        switch (value->type) {
+            case METRIC_COUNTER:
+                ostr_print(&out, "# TYPE %v counter\n", value->name);
+                ostr_print(&out, "%v %llu\n", value->name, value->value);
+                break;
+
+            case METRIC_GAUGE:
+                ostr_print(&out, "# TYPE %v gauge\n", value->name);
+                ostr_print(&out, "%v %lld\n", value->name, value->gauge);
+                break;
+
+            case METRIC_HISTOGRAM:
+            {
+                ostr_print(&out, "# TYPE %v histogram\n", value->name);
+                // the same bounds every time (0, 1, 3, 7, ... 2^63 - 1) so that
+                // rates and quantiles work across scrapes, all 500+ buckets
+                // would be too many
+                u64 cumulative = 0;
+                for (u32 i = 0; i < METRICS_HISTOGRAM_BUCKETS; ++i) {
+                    cumulative += value->buckets[i];
+                    u64 upper = metrics__bucket_upper(i);
+                    // the last bucket has no upper bound, +Inf covers it
+                    if (upper == UINT64_MAX) break;
+                    if ((upper + 1) & upper) continue;
+                    ostr_print(&out, "%v_bucket{le=\"%llu\"} %llu\n", value->name, upper, cumulative);
+                }
+                ostr_print(&out, "%v_bucket{le=\"+Inf\"} %llu\n", value->name, value->value);
+                ostr_print(&out, "%v_sum %llu\n", value->name, value->sum);
+                ostr_print(&out, "%v_count %llu\n", value->name, value->value);
+                break;
+            }
+        }
+    }
+
+    return ostr_to_str(&out);
+}
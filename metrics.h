@@ -0,0 +1,115 @@
+#ifndef COLLA_METRICS_H
+#define COLLA_METRICS_H
+
+#include "core.h"
+#include "str.h"
+#include "arena.h"
+
+// process wide registry of counters, gauges and histograms. counters and
+// histograms are sharded per thread, recording is a thread local add with no
+// locks or shared cache lines, the shards are only summed up by a snapshot.
+// gauges are a single shared atomic value
+//
+// recording into a NULL metric does nothing, so the library can publish its
+// own metrics (see metrics_colla) whether metrics_init was called or not
+//
+// when a thread started with os_thread_launch exits its values are folded into
+// a single retired shard and its memory is reused by the next thread. threads
+// created in other ways keep their shard until metrics_cleanup
+
+typedef enum metric_type_e {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_HISTOGRAM,
+} metric_type_e;
+
+// histograms keep 8 linear buckets for every power of two, so a bucket is
+// never more than 12.5% wide. values below 8 get a bucket each
+#define METRICS_SUB_BUCKET_BITS   (3)
+#define METRICS_SUB_BUCKETS       (1 << METRICS_SUB_BUCKET_BITS)
+#define METRICS_HISTOGRAM_BUCKETS ((64 - METRICS_SUB_BUCKET_BITS + 1) * METRICS_SUB_BUCKETS)
+
+typedef struct metric_t metric_t;
+struct metric_t {
+    str_t name;
+    str_t help;
+    metric_type_e type;
+    // first slot in the thread shards, counters use one and histograms
+    // METRICS_HISTOGRAM_BUCKETS + 1 (the last one is the sum)
+    u32 slot;
+    volatile u64 gauge;
+    metric_t *next;
+};
+
+typedef struct metric_value_t metric_value_t;
+struct metric_value_t {
+    str_t name;
+    str_t help;
+    metric_type_e type;
+    u64 value; // counter value, or number of values in a histogram
+    i64 gauge;
+    u64 sum;
+    u64 *buckets; // METRICS_HISTOGRAM_BUCKETS counts, only for histograms
+    metric_value_t *next;
+};
+
+typedef struct metrics_snapshot_t metrics_snapshot_t;
+struct metrics_snapshot_t {
+    metric_value_t *head;
+    metric_value_t *tail;
+};
+
+// metrics published by colla itself, NULL until metrics_init
+typedef struct metrics_colla_t metrics_colla_t;
+struct metrics_colla_t {
+    metric_t *arena_commits;
+    metric_t *arena_commit_bytes; // bytes asked of os_commit, not the memory in use
+    metric_t *net_sent_bytes;
+    metric_t *net_received_bytes;
+    metric_t *http_requests;
+    metric_t *http_failures;
+    metric_t *http_duration_ns;
+};
+
+extern metrics_colla_t metrics_colla;
+
+typedef struct metrics_desc_t metrics_desc_t;
+struct metrics_desc_t {
+    u32 max_slots; // size of each thread shard in u64s, defaults to 16384 (about 30 histograms)
+};
+
+// [ u32 max_slots ]
+#define metrics_make(...) metrics_init(&(metrics_desc_t){ __VA_ARGS__ })
+
+bool metrics_init(const metrics_desc_t *desc);
+// nothing can be recording while this runs, every metric_t becomes invalid
+void metrics_cleanup(void);
+
+// registering the same name twice returns the same metric. returns NULL if
+// the types don't match or there are no slots left
+metric_t *metrics_counter(strview_t name, strview_t help);
+metric_t *metrics_gauge(strview_t name, strview_t help);
+metric_t *metrics_histogram(strview_t name, strview_t help);
+
+void metrics_add(metric_t *counter, u64 amount);
+void metrics_gauge_set(metric_t *gauge, i64 value);
+void metrics_gauge_add(metric_t *gauge, i64 amount);
+void metrics_record(metric_t *histogram, u64 value);
+
+// the values of every metric at the time of the call, in registration order
+metrics_snapshot_t metrics_snapshot(arena_t *arena);
+// adds src to dst (e.g. snapshots of different processes), metrics that are
+// only in src are copied over
+void metrics_merge(arena_t *arena, metrics_snapshot_t *dst, metrics_snapshot_t *src);
+metric_value_t *metrics_find(metrics_snapshot_t *snapshot, strview_t name);
+
+// upper bound of the bucket the percentile (0-100) falls in
+u64 metrics_percentile(const metric_value_t *histogram, double percentile);
+u32 metrics_bucket_index(u64 value);
+// smallest value that goes in the bucket
+u64 metrics_bucket_lower(u32 index);
+
+// prometheus text exposition format
+str_t metrics_to_prometheus(arena_t *arena, metrics_snapshot_t *snapshot);
+
+#endif
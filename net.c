@@ -129,7 +129,7 @@ http_res_t http_parse_res(arena_t *arena, strview_t response) {
     res.headers = http__parse_headers_instream(arena, &in);
 
     strview_t encoding = http_get_header(res.headers, strv("transfer-encoding"));
-    if (!strv_equals(encoding, strv("chunked"))) {
+    if (!strv_equals_nocase(encoding, strv("chunked"))) {
         res.body = istr_get_view_len(&in, SIZE_MAX);
     }
     else {
@@ -189,7 +189,7 @@ str_t http_res_to_str(arena_t *arena, http_res_t *res) {
 
 bool http_has_header(http_header_t *headers, strview_t key) {
     for_each(h, headers) {
-        if (strv_equals(h->key, key)) {
+        if (strv_equals_nocase(h->key, key)) {
             return true;
         }
     }
@@ -199,7 +199,7 @@ bool http_has_header(http_header_t *headers, strview_t key) {
 void http_set_header(http_header_t *headers, strview_t key, strview_t value) {
     http_header_t *h = headers;
     while (h) {
-        if (strv_equals(h->key, key)) {
+        if (strv_equals_nocase(h->key, key)) {
             h->value = value;
             break;
         }
@@ -210,7 +210,7 @@ void http_set_header(http_header_t *headers, strview_t key, strview_t value) {
 strview_t http_get_header(http_header_t *headers, strview_t key) {
     http_header_t *h = headers;
     while (h) {
-        if (strv_equals(h->key, key)) {
+        if (strv_equals_nocase(h->key, key)) {
             return h->value;
         }
         h = h->next;
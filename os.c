@@ -1,4 +1,7 @@
 #include "os.h"
+#include "trace.h"
+
+#include <string.h>
 
 #if COLLA_WIN
 	#include "win/os_win32.c"
@@ -35,6 +38,16 @@ os_log_colour_e log__level_to_colour(os_log_level_e level) {
 	return colour;
 }
 
+os_log_level_e os__log_level = LOG_DEBUG;
+
+void os_log_set_level(os_log_level_e level) {
+    os__log_level = MIN(level, LOG_FATAL);
+}
+
+os_log_level_e os_log_get_level(void) {
+    return os__log_level;
+}
+
 void os_log_print(os_log_level_e level, const char *fmt, ...) {
     va_list args;
     va_start(args, fmt);
@@ -42,7 +55,30 @@ void os_log_print(os_log_level_e level, const char *fmt, ...) {
     va_end(args);
 }
 
-void os_log_printv(os_log_level_e level, const char *fmt, va_list args) {
+// implemented by the platform, true if the console understands ANSI escape codes
+bool os__log_use_escapes(void);
+
+// auto-reset events implemented by the platform, wait on them with os_wait_on_handles
+oshandle_t os__event_create(void);
+void os__event_signal(oshandle_t event);
+void os__event_free(oshandle_t event);
+
+const char *log__colour_to_escape(os_log_colour_e colour) {
+    switch (colour) {
+        case LOG_COL_BLACK:   return "\x1b[90m";
+        case LOG_COL_BLUE:    return "\x1b[94m";
+        case LOG_COL_GREEN:   return "\x1b[92m";
+        case LOG_COL_CYAN:    return "\x1b[96m";
+        case LOG_COL_RED:     return "\x1b[91m";
+        case LOG_COL_MAGENTA: return "\x1b[95m";
+        case LOG_COL_YELLOW:  return "\x1b[93m";
+        case LOG_COL_WHITE:   return "\x1b[97m";
+        default: break;
+    }
+    return "\x1b[0m";
+}
+
+const char *log__level_to_str(os_log_level_e level) {
     const char *level_str = "";
     switch (level) {
         case LOG_DEBUG: level_str = "DEBUG"; break;
@@ -52,12 +88,44 @@ void os_log_printv(os_log_level_e level, const char *fmt, va_list args) {
         case LOG_FATAL: level_str = "FATAL"; break;  
 		default: break;  
     }
+    return level_str;
+}
+
+bool log__async_push(os_log_level_e level, const char *fmt, va_list args);
 
-	os_log_set_colour(log__level_to_colour(level));
+void os_log_printv(os_log_level_e level, const char *fmt, va_list args) {
+    // the macros already check this, but os_log_print can be called directly
+    if (level != LOG_BASIC && level < os__log_level) {
+        return;
+    }
+
+    if (os_log_is_async()) {
+        log__async_push(level, fmt, args);
+        if (level == LOG_FATAL) {
+            os_abort(1);
+        }
+        return;
+    }
+
+    const char *level_str = log__level_to_str(level);
+
+    // the whole line goes in the fmt buffer and is written once when the
+    // new line is printed, this only works if the colours are escape codes
     if (level != LOG_BASIC) {
-        fmt_print("[%s]: ", level_str);
+        if (os__log_use_escapes()) {
+            fmt_print(
+                "%s[%s]: %s",
+                log__colour_to_escape(log__level_to_colour(level)),
+                level_str,
+                log__colour_to_escape(LOG_COL_RESET)
+            );
+        }
+        else {
+            os_log_set_colour(log__level_to_colour(level));
+            fmt_print("[%s]: ", level_str);
+            os_log_set_colour(LOG_COL_RESET);
+        }
     }
-    os_log_set_colour(LOG_COL_RESET);
 
     fmt_printv(fmt, args);
     fmt_print("\n");
@@ -67,6 +135,591 @@ void os_log_printv(os_log_level_e level, const char *fmt, va_list args) {
     }
 }
 
+// == ASYNC LOGGING =============================
+
+// the ring buffer is a bounded queue where each slot has a sequence number:
+// a slot is free for position pos when seq == pos, and ready to be written
+// out when seq == pos + 1. producers claim a position by moving head forward
+// with a cas, only the background thread reads from the ring
+
+// positions are u32 and are allowed to wrap around
+
+#define LOG__BATCH_SIZE       (KB(64))
+#define LOG__DEFAULT_CAPACITY (1024)
+
+typedef struct log__slot_t log__slot_t;
+struct log__slot_t {
+    volatile u32 seq;
+    u32 len;
+    char line[OS_LOG_LINE_SIZE];
+};
+
+struct {
+    arena_t arena;
+    log__slot_t *slots;
+    u32 mask;
+    os_log_async_policy_e policy;
+    oshandle_t output;
+    oshandle_t thread;
+    oshandle_t wake_event; // producers -> background thread
+    oshandle_t done_event; // background thread -> flush and blocked producers
+    char *batch;
+    bool use_escapes;
+    bool binary;
+    volatile u32 running;
+    volatile u32 sleeping;
+    volatile u32 dropped;
+    // head is hammered by all the producers, keep it away from the rest
+    u8 pad0[64];
+    volatile u32 head;
+    u8 pad1[64];
+    volatile u32 written;
+} log__async = {0};
+
+u32 log__format_line(char *buf, usize size, os_log_level_e level, const char *fmt, va_list args) {
+    // always leave space for the new line
+    usize cap = size - 1;
+    usize len = 0;
+
+    if (level != LOG_BASIC) {
+        int prefix = 0;
+        if (log__async.use_escapes) {
+            prefix = fmt_buffer(
+                buf, cap,
+                "%s[%s]: %s",
+                log__colour_to_escape(log__level_to_colour(level)),
+                log__level_to_str(level),
+                log__colour_to_escape(LOG_COL_RESET)
+            );
+        }
+        else {
+            prefix = fmt_buffer(buf, cap, "[%s]: ", log__level_to_str(level));
+        }
+        len = MIN((usize)MAX(prefix, 0), cap - 1);
+    }
+
+    int msg = fmt_bufferv(buf + len, cap - len, fmt, args);
+    len += MIN((usize)MAX(msg, 0), cap - len - 1);
+
+    buf[len++] = '\n';
+    return (u32)len;
+}
+
+// == BINARY LOGGING ============================
+
+// the binary log starts with LOG__BIN_MAGIC and a version byte, then a list of records:
+//     format: [u8 LOG__BIN_FORMAT] [u64 id] [u16 len] [format string]
+//     line:   [u8 LOG__BIN_LINE] [u8 level] [u64 id] [u16 len] [arguments]
+//     drop:   [u8 LOG__BIN_DROP] [u32 count]
+// the id is a hash of the format string (never 0). arguments are stored as 4 or 8
+// bytes depending on what stb_sprintf would read, strings as [u16 len] [bytes].
+// a format record can come after the lines that use it
+
+#define LOG__BIN_MAGIC   "CLOG"
+#define LOG__BIN_VERSION 1
+// longer format strings are truncated, and only the arguments of the first part are recorded
+#define LOG__BIN_MAX_FMT (OS_LOG_LINE_SIZE / 2)
+
+typedef enum {
+    LOG__BIN_FORMAT = 1,
+    LOG__BIN_LINE,
+    LOG__BIN_DROP,
+} log__bin_record_e;
+
+typedef enum {
+    LOG__ARG_NONE,
+    LOG__ARG_I32,
+    LOG__ARG_I64,
+    LOG__ARG_F64,
+    LOG__ARG_STR,
+    LOG__ARG_STRV,
+    LOG__ARG_WRITE, // %n, doesn't store anything
+} log__arg_e;
+
+typedef struct log__spec_t log__spec_t;
+struct log__spec_t {
+    usize len; // including the %
+    log__arg_e type;
+    bool star_width;
+    bool star_precision;
+    int precision;
+};
+
+// parses a single specifier with the same rules as stb_sprintf, fmt points to the %
+log__spec_t log__parse_spec(const char *fmt, usize len) {
+    log__spec_t spec = { .precision = -1 };
+    usize i = 1;
+    bool is64 = false;
+
+#define LOG__CUR (i < len ? fmt[i] : '\0')
+
+    while (LOG__CUR && strchr("-+ #'$_", LOG__CUR)) {
+        i++;
+    }
+    if (LOG__CUR == '0') {
+        i++;
+    }
+
+    if (LOG__CUR == '*') {
+        spec.star_width = true;
+        i++;
+    }
+    else {
+        while (LOG__CUR >= '0' && LOG__CUR <= '9') i++;
+    }
+
+    if (LOG__CUR == '.') {
+        i++;
+        if (LOG__CUR == '*') {
+            spec.star_precision = true;
+            i++;
+        }
+        else {
+            spec.precision = 0;
+            while (LOG__CUR >= '0' && LOG__CUR <= '9') {
+                spec.precision = spec.precision * 10 + (LOG__CUR - '0');
+                i++;
+            }
+        }
+    }
+
+    switch (LOG__CUR) {
+        case 'h':
+            i++;
+            if (LOG__CUR == 'h') i++;
+            break;
+        case 'l':
+            is64 = sizeof(long) == 8;
+            i++;
+            if (LOG__CUR == 'l') {
+                is64 = true;
+                i++;
+            }
+            break;
+        case 'j': case 'z': case 't':
+            is64 = sizeof(usize) == 8;
+            i++;
+            break;
+        case 'I':
+            if ((i + 2) < len && fmt[i + 1] == '6' && fmt[i + 2] == '4') {
+                is64 = true;
+                i += 3;
+            }
+            else if ((i + 2) < len && fmt[i + 1] == '3' && fmt[i + 2] == '2') {
+                i += 3;
+            }
+            else {
+                is64 = sizeof(void *) == 8;
+                i++;
+            }
+            break;
+        default: break;
+    }
+
+    switch (LOG__CUR) {
+        case 's': spec.type = LOG__ARG_STR;   break;
+        case 'v': spec.type = LOG__ARG_STRV;  break;
+        case 'n': spec.type = LOG__ARG_WRITE; break;
+        case 'c': spec.type = LOG__ARG_I32;   break;
+        case 'p': spec.type = sizeof(void *) == 8 ? LOG__ARG_I64 : LOG__ARG_I32; break;
+        case 'A': case 'a': case 'G': case 'g':
+        case 'E': case 'e': case 'f':
+            spec.type = LOG__ARG_F64;
+            break;
+        case 'B': case 'b': case 'o': case 'X':
+        case 'x': case 'u': case 'i': case 'd':
+            spec.type = is64 ? LOG__ARG_I64 : LOG__ARG_I32;
+            break;
+        default: break;
+    }
+
+#undef LOG__CUR
+
+    spec.len = MIN(i + 1, len);
+    return spec;
+}
+
+typedef struct log__bin_writer_t log__bin_writer_t;
+struct log__bin_writer_t {
+    u8 *buf;
+    usize len;
+    usize cap;
+};
+
+bool log__bin_write(log__bin_writer_t *w, const void *data, usize size) {
+    if ((w->len + size) > w->cap) {
+        return false;
+    }
+    memcpy(w->buf + w->len, data, size);
+    w->len += size;
+    return true;
+}
+
+bool log__bin_write_str(log__bin_writer_t *w, const char *str, usize len) {
+    usize space = w->cap - w->len;
+    if (space < sizeof(u16)) {
+        return false;
+    }
+    u16 size = (u16)MIN(len, space - sizeof(u16));
+    return log__bin_write(w, &size, sizeof(size)) && log__bin_write(w, str, size);
+}
+
+// every thread remembers which formats it already wrote, so they are written
+// without any synchronisation, at most once per thread (or on a collision)
+#define LOG__BIN_CACHE_SIZE 256
+
+typedef struct log__bin_cache_t log__bin_cache_t;
+struct log__bin_cache_t {
+    u64 formats[LOG__BIN_CACHE_SIZE];
+    u32 generation;
+};
+
+static COLLA_THREAD_LOCAL log__bin_cache_t log__bin_cache = {0};
+// bumped every time a binary log is started, invalidates all the caches
+static u32 log__bin_generation = 0;
+
+bool log__bin_needs_format(u64 id) {
+    log__bin_cache_t *cache = &log__bin_cache;
+    if (cache->generation != log__bin_generation) {
+        memset(cache->formats, 0, sizeof(cache->formats));
+        cache->generation = log__bin_generation;
+    }
+
+    u64 hash = id * 11400714819323198485ull;
+    usize index = (usize)(hash >> 56) & (LOG__BIN_CACHE_SIZE - 1);
+    if (cache->formats[index] == id) {
+        return false;
+    }
+    cache->formats[index] = id;
+    return true;
+}
+
+u32 log__encode_record(u8 *buf, usize size, os_log_level_e level, const char *fmt, va_list args) {
+    log__bin_writer_t w = { .buf = buf, .cap = size };
+
+    usize fmt_len = 0;
+    while (fmt_len < LOG__BIN_MAX_FMT && fmt[fmt_len]) {
+        fmt_len++;
+    }
+
+    // hash of the text rather than its address: a format string built at
+    // runtime (or on the stack) can reuse the address of a different one
+    u64 id = strv_hash(strv_init_len(fmt, fmt_len));
+    // 0 is an empty slot in the caches
+    id = id ? id : 1;
+
+    if (log__bin_needs_format(id)) {
+        u8 kind = LOG__BIN_FORMAT;
+        log__bin_write(&w, &kind, sizeof(kind));
+        log__bin_write(&w, &id, sizeof(id));
+        log__bin_write_str(&w, fmt, fmt_len);
+    }
+
+    u8 kind = LOG__BIN_LINE;
+    u8 lvl = (u8)level;
+    log__bin_write(&w, &kind, sizeof(kind));
+    log__bin_write(&w, &lvl, sizeof(lvl));
+    log__bin_write(&w, &id, sizeof(id));
+
+    usize args_len_pos = w.len;
+    u16 args_len = 0;
+    log__bin_write(&w, &args_len, sizeof(args_len));
+    usize args_beg = w.len;
+
+    // the arguments are only recorded while they fit, the decoder prints
+    // the rest of the format string as is
+    const char *cur = fmt;
+    const char *end = fmt + fmt_len;
+    bool fits = true;
+
+    while (fits && (cur = memchr(cur, '%', end - cur))) {
+        log__spec_t spec = log__parse_spec(cur, end - cur);
+        cur += spec.len;
+
+        int precision = spec.precision;
+        if (spec.star_width) {
+            int width = va_arg(args, int);
+            fits = fits && log__bin_write(&w, &width, sizeof(width));
+        }
+        if (spec.star_precision) {
+            precision = va_arg(args, int);
+            fits = fits && log__bin_write(&w, &precision, sizeof(precision));
+        }
+
+        switch (spec.type) {
+            case LOG__ARG_I32:
+            {
+                i32 value = va_arg(args, i32);
+                fits = fits && log__bin_write(&w, &value, sizeof(value));
+                break;
+            }
+            case LOG__ARG_I64:
+            {
+                i64 value = va_arg(args, i64);
+                fits = fits && log__bin_write(&w, &value, sizeof(value));
+                break;
+            }
+            case LOG__ARG_F64:
+            {
+                double value = va_arg(args, double);
+                fits = fits && log__bin_write(&w, &value, sizeof(value));
+                break;
+            }
+            case LOG__ARG_STR:
+            {
+                const char *str = va_arg(args, const char *);
+                if (!str) str = "null";
+                usize limit = precision >= 0 ? (usize)precision : w.cap;
+                usize len = 0;
+                while (len < limit && str[len]) len++;
+                fits = fits && log__bin_write_str(&w, str, len);
+                break;
+            }
+            case LOG__ARG_STRV:
+            {
+                strview_t view = va_arg(args, strview_t);
+                if (!view.buf) view = strv("null");
+                fits = fits && log__bin_write_str(&w, view.buf, view.len);
+                break;
+            }
+            case LOG__ARG_WRITE:
+                va_arg(args, int *);
+                break;
+            default: break;
+        }
+    }
+
+    args_len = (u16)(w.len - args_beg);
+    memcpy(w.buf + args_len_pos, &args_len, sizeof(args_len));
+
+    return (u32)w.len;
+}
+
+void log__async_wait_done(void) {
+    os__event_signal(log__async.wake_event);
+    os_wait_on_handles(&log__async.done_event, 1, false, 1);
+}
+
+bool log__async_push(os_log_level_e level, const char *fmt, va_list args) {
+    log__slot_t *slot = NULL;
+    u32 pos = atomic_load_u32(&log__async.head, ATOMIC_RELAXED);
+
+    while (true) {
+        slot = &log__async.slots[pos & log__async.mask];
+        u32 seq = atomic_load_u32(&slot->seq, ATOMIC_ACQUIRE);
+        i32 diff = (i32)(seq - pos);
+
+        if (diff == 0) {
+            // on failure pos is updated to the current head
+            if (atomic_cas_u32(&log__async.head, &pos, pos + 1, ATOMIC_RELAXED)) {
+                break;
+            }
+            continue;
+        }
+        else if (diff < 0) {
+            // the ring is full, fatal errors are never dropped
+            if (log__async.policy == LOG_ASYNC_DROP && level != LOG_FATAL) {
+                atomic_add_u32(&log__async.dropped, 1, ATOMIC_RELAXED);
+                return false;
+            }
+            log__async_wait_done();
+        }
+
+        pos = atomic_load_u32(&log__async.head, ATOMIC_RELAXED);
+    }
+
+    if (log__async.binary) {
+        slot->len = log__encode_record((u8 *)slot->line, sizeof(slot->line), level, fmt, args);
+    }
+    else {
+        slot->len = log__format_line(slot->line, sizeof(slot->line), level, fmt, args);
+    }
+    // seq_cst so that it can't be reordered with the load of sleeping below
+    atomic_store_u32(&slot->seq, pos + 1, ATOMIC_SEQ_CST);
+
+    // only wake up the background thread if it is actually waiting, this
+    // way most lines don't need a syscall
+    if (atomic_load_u32(&log__async.sleeping, ATOMIC_SEQ_CST) && atomic_exchange_u32(&log__async.sleeping, 0, ATOMIC_ACQ_REL)) {
+        os__event_signal(log__async.wake_event);
+    }
+
+    return true;
+}
+
+int log__async_thread(u64 thread_id, void *userdata) {
+    COLLA_UNUSED(thread_id); COLLA_UNUSED(userdata);
+
+    char *batch = log__async.batch;
+    usize batch_len = 0;
+    u32 pos = 0;
+    u32 reported_drops = 0;
+
+    while (true) {
+        u32 start = pos;
+
+        while (true) {
+            log__slot_t *slot = &log__async.slots[pos & log__async.mask];
+            if (atomic_load_u32(&slot->seq, ATOMIC_ACQUIRE) != pos + 1) {
+                break;
+            }
+
+            if ((batch_len + slot->len) > LOG__BATCH_SIZE) {
+                os_file_write(log__async.output, batch, batch_len);
+                batch_len = 0;
+            }
+
+            memcpy(batch + batch_len, slot->line, slot->len);
+            batch_len += slot->len;
+
+            // free the slot for the next lap around the ring
+            atomic_store_u32(&slot->seq, pos + log__async.mask + 1, ATOMIC_RELEASE);
+            pos++;
+        }
+
+        u32 dropped = atomic_load_u32(&log__async.dropped, ATOMIC_RELAXED);
+        if (dropped != reported_drops) {
+            if ((batch_len + OS_LOG_LINE_SIZE) > LOG__BATCH_SIZE) {
+                os_file_write(log__async.output, batch, batch_len);
+                batch_len = 0;
+            }
+            u32 count = dropped - reported_drops;
+            if (log__async.binary) {
+                batch[batch_len++] = LOG__BIN_DROP;
+                memcpy(batch + batch_len, &count, sizeof(count));
+                batch_len += sizeof(count);
+            }
+            else {
+                batch_len += fmt_buffer(
+                    batch + batch_len, OS_LOG_LINE_SIZE,
+                    "[WARN]: %u log lines were dropped\n",
+                    count
+                );
+            }
+            reported_drops = dropped;
+        }
+
+        if (batch_len) {
+            os_file_write(log__async.output, batch, batch_len);
+            batch_len = 0;
+        }
+
+        if (pos != start) {
+            atomic_store_u32(&log__async.written, pos, ATOMIC_RELEASE);
+            os__event_signal(log__async.done_event);
+            continue;
+        }
+
+        if (!atomic_load_u32(&log__async.running, ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        // check the ring again after saying that we're going to sleep, so a
+        // producer either sees the flag or we see its line
+        atomic_store_u32(&log__async.sleeping, 1, ATOMIC_SEQ_CST);
+        log__slot_t *next = &log__async.slots[pos & log__async.mask];
+        if (atomic_load_u32(&next->seq, ATOMIC_SEQ_CST) != pos + 1) {
+            os_wait_on_handles(&log__async.wake_event, 1, false, 100);
+        }
+        atomic_store_u32(&log__async.sleeping, 0, ATOMIC_RELAXED);
+    }
+
+    return 0;
+}
+
+bool os_log_async_init(const os_log_async_desc_t *desc) {
+    if (os_log_is_async()) {
+        err("async logging has already been started");
+        return false;
+    }
+
+    os_log_async_desc_t opts = desc ? *desc : (os_log_async_desc_t){0};
+
+    u32 capacity = 1;
+    u32 wanted = opts.capacity ? opts.capacity : LOG__DEFAULT_CAPACITY;
+    while (capacity < wanted) {
+        capacity <<= 1;
+    }
+
+    log__async.arena = arena_make(ARENA_MALLOC, sizeof(log__slot_t) * capacity + LOG__BATCH_SIZE + KB(1));
+    log__async.slots = alloc(&log__async.arena, log__slot_t, capacity, ALLOC_NOZERO);
+    log__async.batch = alloc(&log__async.arena, char, LOG__BATCH_SIZE, ALLOC_NOZERO);
+
+    for (u32 i = 0; i < capacity; ++i) {
+        log__async.slots[i].seq = i;
+    }
+
+    log__async.mask        = capacity - 1;
+    log__async.policy      = opts.policy;
+    log__async.output      = os_handle_valid(opts.output) ? opts.output : os_stdout();
+    log__async.binary      = opts.binary;
+    log__async.use_escapes = !opts.binary && os_handle_match(log__async.output, os_stdout()) && os__log_use_escapes();
+    log__async.wake_event  = os__event_create();
+    log__async.done_event  = os__event_create();
+
+    log__async.head     = 0;
+    log__async.written  = 0;
+    log__async.dropped  = 0;
+    log__async.sleeping = 0;
+
+    // anything printed before this needs to come out first
+    fmt_flush();
+
+    if (log__async.binary) {
+        u8 header[] = { LOG__BIN_MAGIC[0], LOG__BIN_MAGIC[1], LOG__BIN_MAGIC[2], LOG__BIN_MAGIC[3], LOG__BIN_VERSION };
+        os_file_write(log__async.output, header, sizeof(header));
+        log__bin_generation++;
+    }
+
+    atomic_store_u32(&log__async.running, 1, ATOMIC_RELEASE);
+    log__async.thread = os_thread_launch(log__async_thread, NULL);
+
+    if (!os_handle_valid(log__async.thread)) {
+        atomic_store_u32(&log__async.running, 0, ATOMIC_RELEASE);
+        os__event_free(log__async.wake_event);
+        os__event_free(log__async.done_event);
+        arena_cleanup(&log__async.arena);
+        memset(&log__async, 0, sizeof(log__async));
+        err("couldn't start the async logging thread");
+        return false;
+    }
+
+    return true;
+}
+
+void os_log_async_cleanup(void) {
+    if (!os_log_is_async()) {
+        return;
+    }
+
+    atomic_store_u32(&log__async.running, 0, ATOMIC_RELEASE);
+    os__event_signal(log__async.wake_event);
+    os_thread_join(log__async.thread, NULL);
+
+    os__event_free(log__async.wake_event);
+    os__event_free(log__async.done_event);
+    arena_cleanup(&log__async.arena);
+    memset(&log__async, 0, sizeof(log__async));
+}
+
+bool os_log_is_async(void) {
+    return atomic_load_u32(&log__async.running, ATOMIC_ACQUIRE) != 0;
+}
+
+void os_log_flush(void) {
+    if (os_log_is_async()) {
+        u32 target = atomic_load_u32(&log__async.head, ATOMIC_ACQUIRE);
+        while ((i32)(atomic_load_u32(&log__async.written, ATOMIC_ACQUIRE) - target) < 0) {
+            log__async_wait_done();
+        }
+    }
+
+    fmt_flush();
+}
+
+u64 os_log_dropped_count(void) {
+    return (u64)atomic_load_u32(&log__async.dropped, ATOMIC_RELAXED);
+}
+
 // == FILE ======================================
 
 void os_file_split_path(strview_t path, strview_t *dir, strview_t *name, strview_t *ext) {
@@ -118,14 +771,97 @@ usize os_file_write_buf(oshandle_t handle, buffer_t buf) {
 	return os_file_write(handle, buf.data, buf.len);
 }
 
+#define OS__VEC_STAGING_SIZE (KB(4))
+
+usize os_file_readv(oshandle_t handle, buffer_t *bufs, usize count) {
+	u8 staging[OS__VEC_STAGING_SIZE];
+	usize total = 0;
+	usize i = 0;
+
+	while (i < count) {
+		// gather as many small buffers as fit in the staging area
+		usize staged_len = 0;
+		usize end = i;
+		while (end < count && (staged_len + bufs[end].len) <= sizeof(staging)) {
+			staged_len += bufs[end].len;
+			end++;
+		}
+
+		// a single buffer (or one too big to stage) is read straight into place
+		if ((end - i) <= 1) {
+			usize read = os_file_read(handle, bufs[i].data, bufs[i].len);
+			total += read;
+			if (read < bufs[i].len) break;
+			i++;
+			continue;
+		}
+
+		usize read = os_file_read(handle, staging, staged_len);
+		total += read;
+
+		usize offset = 0;
+		for (; i < end; ++i) {
+			usize len = MIN(bufs[i].len, read - offset);
+			memcpy(bufs[i].data, staging + offset, len);
+			offset += len;
+		}
+
+		if (read < staged_len) break;
+	}
+
+	return total;
+}
+
+usize os_file_writev(oshandle_t handle, buffer_t *bufs, usize count) {
+	u8 staging[OS__VEC_STAGING_SIZE];
+	usize total = 0;
+	usize i = 0;
+
+	while (i < count) {
+		// gather as many small buffers as fit in the staging area
+		usize staged_len = 0;
+		usize end = i;
+		while (end < count && (staged_len + bufs[end].len) <= sizeof(staging)) {
+			staged_len += bufs[end].len;
+			end++;
+		}
+
+		// a single buffer (or one too big to stage) is written from where it is
+		if ((end - i) <= 1) {
+			buffer_t buf = bufs[i];
+			usize written = os_file_write(handle, buf.data, buf.len);
+			total += written;
+			if (written != buf.len) break;
+			i++;
+			continue;
+		}
+
+		usize offset = 0;
+		for (; i < end; ++i) {
+			memcpy(staging + offset, bufs[i].data, bufs[i].len);
+			offset += bufs[i].len;
+		}
+
+		usize written = os_file_write(handle, staging, staged_len);
+		total += written;
+		if (written != staged_len) break;
+	}
+
+	return total;
+}
+
 buffer_t os_file_read_all(arena_t *arena, strview_t path) {
-	oshandle_t fp = os_file_open(path, FILEMODE_READ);
-	if (!os_handle_valid(fp)) {
-		err("could not open file: %v", path);
-		return (buffer_t){0};
+	buffer_t out = {0};
+	TRACE_SCOPE("os_file_read_all") {
+		oshandle_t fp = os_file_open(path, FILEMODE_READ);
+		if (!os_handle_valid(fp)) {
+			err("could not open file: %v", path);
+		}
+		else {
+			out = os_file_read_all_fp(arena, fp);
+			os_file_close(fp);
+		}
 	}
-	buffer_t out = os_file_read_all_fp(arena, fp);
-	os_file_close(fp);
 	return out;
 }
 
@@ -147,13 +883,17 @@ buffer_t os_file_read_all_fp(arena_t *arena, oshandle_t handle) {
 }
 
 str_t os_file_read_all_str(arena_t *arena, strview_t path) {
-	oshandle_t fp = os_file_open(path, FILEMODE_READ);
-	if (!os_handle_valid(fp)) {
-		err("could not open file %v", path);
-		return STR_EMPTY;
+	str_t out = STR_EMPTY;
+	TRACE_SCOPE("os_file_read_all_str") {
+		oshandle_t fp = os_file_open(path, FILEMODE_READ);
+		if (!os_handle_valid(fp)) {
+			err("could not open file %v", path);
+		}
+		else {
+			out = os_file_read_all_str_fp(arena, fp);
+			os_file_close(fp);
+		}
 	}
-	str_t out = os_file_read_all_str_fp(arena, fp);
-	os_file_close(fp);
 	return out;
 }
 
@@ -218,6 +958,100 @@ bool os_run_cmd(arena_t scratch, os_cmd_t *cmd, os_env_t *optional_env) {
 	return os_handle_valid(proc) ? os_process_wait(proc, OS_WAIT_INFINITE, NULL) : false;
 }
 
+// == TIME ======================================
+
+#define OS__CALIBRATION_NS (10 * 1000 * 1000)
+
+volatile u64 os__cycles_frequency = 0;
+// the slowest os_sleep_ms(1) seen so far, 0 until os_sleep_precise_ns seeds it
+volatile u64 os__sleep_estimate_ns = 0;
+
+// implemented by the platform, how long a scheduler tick is right now
+u64 os__sleep_granularity_ns(void);
+
+u64 os_cycles(void) {
+#if (COLLA_GCC || COLLA_CLANG) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_ia32_rdtsc();
+#elif (COLLA_GCC || COLLA_CLANG) && defined(__aarch64__)
+    u64 value;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#elif COLLA_MSVC && (defined(_M_X64) || defined(_M_IX86))
+    return __rdtsc();
+#elif COLLA_MSVC && defined(_M_ARM64)
+    return _ReadStatusReg(ARM64_CNTVCT);
+#elif COLLA_TCC
+    u32 lo, hi;
+    __asm__ __volatile__("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((u64)hi << 32) | lo;
+#else
+    return os_now_ns();
+#endif
+}
+
+u64 os_cycles_frequency(void) {
+    u64 frequency = atomic_load_u64(&os__cycles_frequency, ATOMIC_RELAXED);
+    if (frequency) {
+        return frequency;
+    }
+
+    u64 start_ns = os_now_ns();
+    u64 start_cycles = os_cycles();
+    u64 elapsed = 0;
+    while (elapsed < OS__CALIBRATION_NS) {
+        cpu_relax();
+        elapsed = os_now_ns() - start_ns;
+    }
+    u64 cycles = os_cycles() - start_cycles;
+
+    // cycles * 1e9 overflows after a few seconds worth of cycles, it's only 10ms
+    frequency = cycles * 1000000000ull / elapsed;
+    frequency = MAX(frequency, 1);
+    atomic_store_u64(&os__cycles_frequency, frequency, ATOMIC_RELAXED);
+    return frequency;
+}
+
+u64 os_cycles_to_ns(u64 cycles) {
+    u64 frequency = os_cycles_frequency();
+    u64 seconds = cycles / frequency;
+    u64 rest = cycles % frequency;
+    return seconds * 1000000000ull + rest * 1000000000ull / frequency;
+}
+
+void os_sleep_precise_ns(u64 nanoseconds) {
+    u64 now = os_now_ns();
+    u64 deadline = now + nanoseconds;
+
+    // without a first guess this big the very first sleep could overshoot by a
+    // whole tick (15.6ms by default) before the estimate catches up
+    if (!atomic_load_u64(&os__sleep_estimate_ns, ATOMIC_RELAXED)) {
+        atomic_store_u64(&os__sleep_estimate_ns, os__sleep_granularity_ns() + 1000000ull, ATOMIC_RELAXED);
+    }
+
+    // os_sleep_ms(1) can take a lot longer than a millisecond (up to a full
+    // scheduler tick), so only sleep while there is more time left than the
+    // slowest one we have seen
+    while (now < deadline) {
+        u64 estimate = atomic_load_u64(&os__sleep_estimate_ns, ATOMIC_RELAXED);
+        if ((deadline - now) <= estimate) {
+            break;
+        }
+
+        os_sleep_ms(1);
+        u64 after = os_now_ns();
+        u64 took = after - now;
+        now = after;
+
+        // jump up to slower sleeps right away, drift down slowly
+        estimate = took > estimate ? took : estimate - (estimate - took) / 16;
+        atomic_store_u64(&os__sleep_estimate_ns, estimate, ATOMIC_RELAXED);
+    }
+
+    while (os_now_ns() < deadline) {
+        cpu_relax();
+    }
+}
+
 // == VMEM ======================================
 
 usize os_pad_to_page(usize byte_count) {
@@ -233,3 +1067,186 @@ usize os_pad_to_page(usize byte_count) {
     }
     return byte_count + padding;
 }
+
+// == LIGHTWEIGHT SYNC ==========================
+
+// how many times to check again before going to sleep on the futex
+#define OS__SPIN_COUNT (100)
+
+void os_lock_acquire(os_lock_t *lock) {
+    u32 state = 0;
+    if (atomic_cas_u32(&lock->state, &state, 1, ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    for (int i = 0; i < OS__SPIN_COUNT; ++i) {
+        cpu_relax();
+        state = 0;
+        if (atomic_load_u32(&lock->state, ATOMIC_RELAXED) == 0 &&
+            atomic_cas_u32(&lock->state, &state, 1, ATOMIC_ACQUIRE)
+        ) {
+            return;
+        }
+    }
+
+    // from here on we don't know if there are other waiters, so always mark
+    // it as contended, the unlock will do a useless wake at worst
+    while (atomic_exchange_u32(&lock->state, 2, ATOMIC_ACQUIRE) != 0) {
+        os_futex_wait(&lock->state, 2, OS_WAIT_INFINITE);
+    }
+}
+
+void os_lock_release(os_lock_t *lock) {
+    if (atomic_exchange_u32(&lock->state, 0, ATOMIC_RELEASE) == 2) {
+        os_futex_wake_one(&lock->state);
+    }
+}
+
+bool os_lock_try_acquire(os_lock_t *lock) {
+    u32 state = 0;
+    return atomic_cas_u32(&lock->state, &state, 1, ATOMIC_ACQUIRE);
+}
+
+#define OS__RW_WRITER  (0x80000000u)
+#define OS__RW_WAITING (0x40000000u)
+#define OS__RW_READERS (0x3fffffffu)
+
+// sets the waiting bit and sleeps, returns the new state to try again with
+u32 os__rwlock_sleep(os_rwlock_t *lock, u32 state) {
+    if (!(state & OS__RW_WAITING)) {
+        if (!atomic_cas_u32(&lock->state, &state, state | OS__RW_WAITING, ATOMIC_RELAXED)) {
+            return state;
+        }
+        state |= OS__RW_WAITING;
+    }
+    os_futex_wait(&lock->state, state, OS_WAIT_INFINITE);
+    return atomic_load_u32(&lock->state, ATOMIC_RELAXED);
+}
+
+void os_rwlock_read(os_rwlock_t *lock) {
+    u32 state = atomic_load_u32(&lock->state, ATOMIC_RELAXED);
+    int spin = 0;
+
+    while (true) {
+        if (!(state & OS__RW_WRITER)) {
+            if (atomic_cas_u32(&lock->state, &state, state + 1, ATOMIC_ACQUIRE)) {
+                return;
+            }
+            continue;
+        }
+
+        if (spin++ < OS__SPIN_COUNT) {
+            cpu_relax();
+            state = atomic_load_u32(&lock->state, ATOMIC_RELAXED);
+            continue;
+        }
+
+        state = os__rwlock_sleep(lock, state);
+    }
+}
+
+void os_rwlock_read_release(os_rwlock_t *lock) {
+    u32 state = atomic_add_u32(&lock->state, (u32)-1, ATOMIC_RELEASE) - 1;
+
+    // last reader out wakes up the waiters. if someone got in before the
+    // cas, they will do it when they leave
+    if (state == OS__RW_WAITING && atomic_cas_u32(&lock->state, &state, 0, ATOMIC_RELAXED)) {
+        os_futex_wake_all(&lock->state);
+    }
+}
+
+void os_rwlock_write(os_rwlock_t *lock) {
+    u32 state = atomic_load_u32(&lock->state, ATOMIC_RELAXED);
+    int spin = 0;
+
+    while (true) {
+        if (!(state & (OS__RW_WRITER | OS__RW_READERS))) {
+            if (atomic_cas_u32(&lock->state, &state, state | OS__RW_WRITER, ATOMIC_ACQUIRE)) {
+                return;
+            }
+            continue;
+        }
+
+        if (spin++ < OS__SPIN_COUNT) {
+            cpu_relax();
+            state = atomic_load_u32(&lock->state, ATOMIC_RELAXED);
+            continue;
+        }
+
+        state = os__rwlock_sleep(lock, state);
+    }
+}
+
+void os_rwlock_write_release(os_rwlock_t *lock) {
+    if (atomic_exchange_u32(&lock->state, 0, ATOMIC_RELEASE) & OS__RW_WAITING) {
+        os_futex_wake_all(&lock->state);
+    }
+}
+
+void os_sema_post(os_sema_t *sema, u32 count) {
+    if (count == 0) {
+        return;
+    }
+
+    // seq_cst so the load of waiters can't move before the add, see os_sema_wait
+    atomic_add_u32(&sema->count, count, ATOMIC_SEQ_CST);
+    if (atomic_load_u32(&sema->waiters, ATOMIC_SEQ_CST)) {
+        if (count == 1) {
+            os_futex_wake_one(&sema->count);
+        }
+        else {
+            os_futex_wake_all(&sema->count);
+        }
+    }
+}
+
+bool os_sema_try_wait(os_sema_t *sema) {
+    u32 count = atomic_load_u32(&sema->count, ATOMIC_RELAXED);
+    while (count) {
+        if (atomic_cas_u32(&sema->count, &count, count - 1, ATOMIC_ACQUIRE)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void os_sema_wait(os_sema_t *sema) {
+    for (int i = 0; i < OS__SPIN_COUNT; ++i) {
+        if (os_sema_try_wait(sema)) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    while (!os_sema_try_wait(sema)) {
+        atomic_add_u32(&sema->waiters, 1, ATOMIC_SEQ_CST);
+        os_futex_wait(&sema->count, 0, OS_WAIT_INFINITE);
+        atomic_add_u32(&sema->waiters, (u32)-1, ATOMIC_RELAXED);
+    }
+}
+
+// 0 not set, 1 set, 2 not set with waiters
+void os_event_signal(os_event_t *event) {
+    if (atomic_exchange_u32(&event->state, 1, ATOMIC_RELEASE) == 2) {
+        os_futex_wake_all(&event->state);
+    }
+}
+
+bool os_event_is_set(os_event_t *event) {
+    return atomic_load_u32(&event->state, ATOMIC_ACQUIRE) == 1;
+}
+
+void os_event_wait(os_event_t *event) {
+    for (int i = 0; i < OS__SPIN_COUNT; ++i) {
+        if (os_event_is_set(event)) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    u32 state = 0;
+    atomic_cas_u32(&event->state, &state, 2, ATOMIC_ACQUIRE);
+    while (!os_event_is_set(event)) {
+        os_futex_wait(&event->state, 2, OS_WAIT_INFINITE);
+    }
+}
@@ -81,14 +81,87 @@ void os_log_set_colour(os_log_colour_e colour);
 oshandle_t os_stdout(void);
 oshandle_t os_stdin(void);
 
+// async logging: the calling thread only formats the line into a slot of a
+// lock-free ring buffer, a background thread then writes the lines in batches.
+// lines longer than OS_LOG_LINE_SIZE are truncated
+
+#ifndef OS_LOG_LINE_SIZE
+#define OS_LOG_LINE_SIZE 512
+#endif
+
+typedef enum {
+    LOG_ASYNC_DROP,  // default, if the ring is full the line is dropped and counted
+    LOG_ASYNC_BLOCK, // if the ring is full, wait for the background thread to make space
+} os_log_async_policy_e;
+
+typedef struct os_log_async_desc_t os_log_async_desc_t;
+struct os_log_async_desc_t {
+    oshandle_t output;             // defaults to os_stdout
+    u32 capacity;                  // number of lines the ring can hold, rounded up to a power of 2, defaults to 1024
+    os_log_async_policy_e policy;
+    // instead of formatting the line, only a hash of the format string and the
+    // raw arguments are recorded, the format string itself is only written the
+    // first time it's used (so formats built at runtime work too). turn the
+    // output back into text with tools/log_decode.c
+    bool binary;
+};
+
+// oshandle_t output, u32 capacity, os_log_async_policy_e policy, bool binary
+#define os_log_async_make(...) os_log_async_init(&(os_log_async_desc_t){ __VA_ARGS__ })
+
+bool os_log_async_init(const os_log_async_desc_t *desc);
+// flushes the remaining lines and stops the background thread, all the
+// threads that log must be done before calling this
+void os_log_async_cleanup(void);
+bool os_log_is_async(void);
+// blocks until everything logged so far has been written, LOG_FATAL does this
+// automatically before aborting
+void os_log_flush(void);
+// number of lines dropped since the async logger was started
+u64 os_log_dropped_count(void);
+
+// lines below the minimum level are skipped before any of the arguments are
+// evaluated, LOG_BASIC and LOG_FATAL are always printed
+void os_log_set_level(os_log_level_e level);
+os_log_level_e os_log_get_level(void);
+
+extern os_log_level_e os__log_level;
+#define os__log_at(level, ...) ((level) >= os__log_level ? os_log_print(level, __VA_ARGS__) : (void)0)
+
+// debug, info, warn and err below this level are compiled out completely and
+// their arguments are never evaluated, as with the enum: 1 debug, 2 info, 3 warn, 4 err
+#ifndef COLLA_LOG_MIN_LEVEL
+#define COLLA_LOG_MIN_LEVEL 0
+#endif
+
 #define print(...)   fmt_print(__VA_ARGS__)
 #define println(...) os_log_print(LOG_BASIC, __VA_ARGS__)
-#define debug(...)   os_log_print(LOG_DEBUG, __VA_ARGS__)
-#define info(...)    os_log_print(LOG_INFO,  __VA_ARGS__)
-#define warn(...)    os_log_print(LOG_WARN,  __VA_ARGS__)
-#define err(...)     os_log_print(LOG_ERR,   __VA_ARGS__)
 #define fatal(...)   os_log_print(LOG_FATAL, __VA_ARGS__)
 
+#if COLLA_LOG_MIN_LEVEL <= 1
+    #define debug(...) os__log_at(LOG_DEBUG, __VA_ARGS__)
+#else
+    #define debug(...) ((void)0)
+#endif
+
+#if COLLA_LOG_MIN_LEVEL <= 2
+    #define info(...)  os__log_at(LOG_INFO,  __VA_ARGS__)
+#else
+    #define info(...)  ((void)0)
+#endif
+
+#if COLLA_LOG_MIN_LEVEL <= 3
+    #define warn(...)  os__log_at(LOG_WARN,  __VA_ARGS__)
+#else
+    #define warn(...)  ((void)0)
+#endif
+
+#if COLLA_LOG_MIN_LEVEL <= 4
+    #define err(...)   os__log_at(LOG_ERR,   __VA_ARGS__)
+#else
+    #define err(...)   ((void)0)
+#endif
+
 // == FILE ======================================
 
 typedef enum filemode_e {
@@ -115,11 +188,25 @@ usize os_file_write(oshandle_t handle, const void *buf, usize len);
 usize os_file_read_buf(oshandle_t handle, buffer_t *buf);
 usize os_file_write_buf(oshandle_t handle, buffer_t buf);
 
+// read/write at an absolute offset, several threads can use the same handle at
+// the same time without seeking. the cursor is left in an unspecified position
+usize os_file_read_at(oshandle_t handle, void *buf, usize len, u64 offset);
+usize os_file_write_at(oshandle_t handle, const void *buf, usize len, u64 offset);
+
+// windows has no vectored i/o for buffered handles (WriteFileGather needs
+// unbuffered handles and page sized buffers), so runs of small buffers that fit
+// in 4KB are copied into a stack buffer and go out in a single call. anything
+// bigger is its own call, e.g. a header and a large body are two writes
+usize os_file_readv(oshandle_t handle, buffer_t *bufs, usize count);
+usize os_file_writev(oshandle_t handle, buffer_t *bufs, usize count);
+
 bool os_file_seek(oshandle_t handle, usize offset);
 bool os_file_seek_end(oshandle_t handle);
 void os_file_rewind(oshandle_t handle);
 usize os_file_tell(oshandle_t handle);
 usize os_file_size(oshandle_t handle);
+// grows or truncates the file, the cursor is left in an unspecified position
+bool os_file_set_size(oshandle_t handle, u64 size);
 bool os_file_is_finished(oshandle_t handle);
 
 buffer_t os_file_read_all(arena_t *arena, strview_t path);
@@ -138,6 +225,116 @@ u64 os_file_time(strview_t path);
 u64 os_file_time_fp(oshandle_t handle);
 bool os_file_has_changed(strview_t path, u64 last_change);
 
+// == FILE MAPPING ==============================
+
+typedef enum {
+    OS_MAP_DEFAULT    = 0,
+    OS_MAP_SEQUENTIAL = 1 << 0, // the file will be read front to back
+    OS_MAP_WILLNEED   = 1 << 1, // start loading the whole file right away
+} os_map_flags_e;
+
+// read-only view of a whole file, anything pointing inside of it is only
+// valid until os_file_unmap is called
+typedef struct os_file_map_t os_file_map_t;
+struct os_file_map_t {
+    union {
+        buffer_t data;
+        strview_t text;
+    };
+    oshandle_t file;
+    oshandle_t mapping;
+};
+
+os_file_map_t os_file_map(strview_t path, os_map_flags_e flags);
+void os_file_unmap(os_file_map_t *map);
+bool os_file_map_is_valid(os_file_map_t *map);
+
+// == ASYNC IO ==================================
+
+// requests are executed by a pool of threads with positioned reads and writes,
+// so any handle from os_file_open works and the file cursor is not used.
+// completed requests are collected with os_aio_wait on the calling thread
+
+typedef enum {
+    OS_AIO_READ,
+    OS_AIO_WRITE,
+} os_aio_op_e;
+
+typedef struct os_aio_req_t os_aio_req_t;
+typedef void (os_aio_callback_t)(os_aio_req_t *req);
+
+// must stay alive and untouched until os_aio_wait has collected it, even if
+// done is already set
+struct os_aio_req_t {
+    os_aio_op_e op;
+    oshandle_t file;
+    void *buf;
+    usize len;
+    u64 offset;
+    os_aio_callback_t *callback; // optional, called from os_aio_wait
+    void *userdata;
+    // set on completion, done is set last so it can be polled from any thread
+    usize result;
+    bool failed;
+    volatile u32 done;
+};
+
+typedef struct os_aio_desc_t os_aio_desc_t;
+struct os_aio_desc_t {
+    u32 thread_count; // defaults to twice the number of processors
+};
+
+typedef struct os_aio_t os_aio_t;
+
+// arena_t *arena, [ u32 thread_count ]
+#define os_aio_make(arenaptr, ...) os_aio_init(arenaptr, &(os_aio_desc_t){ __VA_ARGS__ })
+
+os_aio_t *os_aio_init(arena_t *arena, const os_aio_desc_t *desc);
+// waits for all the pending requests before stopping the threads
+void os_aio_cleanup(os_aio_t *aio);
+
+// returns how many requests were queued, if it's less than count the ones after
+// that were not submitted
+usize os_aio_submit(os_aio_t *aio, os_aio_req_t *reqs, usize count);
+// waits until at least min_count requests are completed (or the timeout
+// expires, it's the total time spent in here), runs their callbacks and
+// returns how many were collected
+usize os_aio_wait(os_aio_t *aio, usize min_count, u32 milliseconds);
+usize os_aio_pending(os_aio_t *aio);
+
+// == WATCH =====================================
+
+typedef enum {
+    OS_WATCH_CREATED,
+    OS_WATCH_MODIFIED,
+    OS_WATCH_DELETED, // renames are reported as a delete and a create
+} os_watch_kind_e;
+
+typedef struct os_watch_event_t os_watch_event_t;
+struct os_watch_event_t {
+    os_watch_kind_e kind;
+    str_t path; // relative to the watched directory
+};
+
+typedef struct os_watch_events_t os_watch_events_t;
+struct os_watch_events_t {
+    os_watch_event_t *events;
+    usize count;
+    // too many changes happened at once and some were lost, rescan everything
+    bool overflow;
+};
+
+typedef struct os_watch_t os_watch_t;
+
+// path can be a directory or a single file, recursive only matters for directories
+os_watch_t *os_watch_open(arena_t *arena, strview_t path, bool recursive);
+void os_watch_close(os_watch_t *watch);
+bool os_watch_is_valid(os_watch_t *watch);
+// signalled when there are events to read, use it with os_wait_on_handles
+oshandle_t os_watch_handle(os_watch_t *watch);
+// never blocks, returns the events received since the last call
+os_watch_events_t os_watch_read(arena_t *arena, os_watch_t *watch);
+
 // == DIR WALKER ================================
 
 typedef enum dir_type_e {
@@ -162,6 +359,38 @@ void os_dir_close(dir_t *dir);
 
 dir_entry_t *os_dir_next(arena_t *arena, dir_t *dir);
 
+// recursive walk, subdirectories are spread over a pool of threads which each
+// have their own arena, so the order of the entries is not deterministic
+
+typedef struct os_walk_entry_t os_walk_entry_t;
+struct os_walk_entry_t {
+    str_t path; // root/sub/dir/name
+    dir_type_e type;
+    usize file_size;
+};
+
+// called from the worker threads, possibly at the same time
+typedef void (os_walk_callback_t)(const os_walk_entry_t *entry, void *userdata);
+
+typedef struct os_walk_desc_t os_walk_desc_t;
+struct os_walk_desc_t {
+    u32 thread_count;             // defaults to the number of processors
+    os_walk_callback_t *callback; // if set, the entries are not collected
+    void *userdata;
+};
+
+typedef struct os_walk_result_t os_walk_result_t;
+struct os_walk_result_t {
+    os_walk_entry_t *entries;
+    usize count;
+};
+
+// arena_t *arena, strview_t root, [ u32 thread_count, os_walk_callback_t *callback, void *userdata ]
+#define os_dir_walk_make(arenaptr, root, ...) os_dir_walk(arenaptr, root, &(os_walk_desc_t){ __VA_ARGS__ })
+
+// symbolic links and junctions are listed but never followed
+os_walk_result_t os_dir_walk(arena_t *arena, strview_t root, const os_walk_desc_t *desc);
+
 // == PROCESS ===================================
 
 typedef struct os_env_t os_env_t;
@@ -182,10 +411,28 @@ bool os_commit(void *ptr, usize num_of_pages);
 bool os_release(void *ptr, usize size);
 usize os_pad_to_page(usize byte_count);
 
+// == TIME ======================================
+
+// monotonic clock in nanoseconds, only useful to measure intervals
+u64 os_now_ns(void);
+
+// raw cpu timestamp counter (rdtsc on x86, cntvct on arm64), much cheaper than
+// os_now_ns but in an unknown unit. falls back to os_now_ns elsewhere
+u64 os_cycles(void);
+// cycles per second, measured against os_now_ns the first time it is called (~10ms)
+u64 os_cycles_frequency(void);
+u64 os_cycles_to_ns(u64 cycles);
+
+void os_sleep_ms(u32 milliseconds);
+// sleeps for most of the time and spins for the rest, far more accurate than
+// os_sleep_ms but it keeps a core busy for the last few milliseconds
+void os_sleep_precise_ns(u64 nanoseconds);
+
 // == THREAD ====================================
 
 typedef int (thread_func_t)(u64 thread_id, void *userdata);
 
+// returns an invalid handle if the thread couldn't be created
 oshandle_t os_thread_launch(thread_func_t func, void *userdata);
 bool os_thread_detach(oshandle_t thread);
 bool os_thread_join(oshandle_t thread, int *code);
@@ -200,6 +447,60 @@ void os_mutex_lock(oshandle_t mutex);
 void os_mutex_unlock(oshandle_t mutex);
 bool os_mutex_try_lock(oshandle_t mutex);
 
+// == FUTEX =====================================
+
+// sleeps while *addr == expected, it can return early or spuriously so always
+// check the value again. returns false on timeout
+bool os_futex_wait(volatile u32 *addr, u32 expected, u32 milliseconds);
+void os_futex_wake_one(volatile u32 *addr);
+void os_futex_wake_all(volatile u32 *addr);
+
+// == LIGHTWEIGHT SYNC ==========================
+
+// small primitives that live wherever you put them: no allocation, zero
+// initialise them and they are ready. they spin for a bit before sleeping
+// on the futex, and don't need to be freed
+
+typedef struct os_lock_t os_lock_t;
+struct os_lock_t {
+    volatile u32 state; // 0 unlocked, 1 locked, 2 locked with waiters
+};
+
+void os_lock_acquire(os_lock_t *lock);
+void os_lock_release(os_lock_t *lock);
+bool os_lock_try_acquire(os_lock_t *lock);
+
+// readers are preferred, a constant stream of readers can starve writers
+typedef struct os_rwlock_t os_rwlock_t;
+struct os_rwlock_t {
+    volatile u32 state;
+};
+
+void os_rwlock_read(os_rwlock_t *lock);
+void os_rwlock_read_release(os_rwlock_t *lock);
+void os_rwlock_write(os_rwlock_t *lock);
+void os_rwlock_write_release(os_rwlock_t *lock);
+
+typedef struct os_sema_t os_sema_t;
+struct os_sema_t {
+    volatile u32 count;
+    volatile u32 waiters;
+};
+
+void os_sema_post(os_sema_t *sema, u32 count);
+void os_sema_wait(os_sema_t *sema);
+bool os_sema_try_wait(os_sema_t *sema);
+
+// one-shot event, once signalled it stays signalled
+typedef struct os_event_t os_event_t;
+struct os_event_t {
+    volatile u32 state;
+};
+
+void os_event_signal(os_event_t *event);
+void os_event_wait(os_event_t *event);
+bool os_event_is_set(os_event_t *event);
+
 #if !COLLA_NO_CONDITION_VARIABLE
 // == CONDITION VARIABLE ========================
 
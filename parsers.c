@@ -1,15 +1,24 @@
 #include "parsers.h"
 
+#include <errno.h>
+
 #include "os.h"
+#include "trace.h"
 
 // == INI ============================================
 
 void ini__parse(arena_t *arena, ini_t *ini, const iniopt_t *options);
+void *ini__index_get(iniindex_t *index, strview_t key);
+usize ini__bind(inischema_t *schema, strview_t text, void *out, const iniopt_t *options);
+iniopt_t ini__get_options(const iniopt_t *options);
 
 ini_t ini_parse(arena_t *arena, strview_t filename, iniopt_t *opt) {
-    oshandle_t fp = os_file_open(filename, FILEMODE_READ);
-    ini_t out = ini_parse_fp(arena, fp, opt);
-    os_file_close(fp);
+    ini_t out = {0};
+    TRACE_SCOPE("ini_parse") {
+        oshandle_t fp = os_file_open(filename, FILEMODE_READ);
+        out = ini_parse_fp(arena, fp, opt);
+        os_file_close(fp);
+    }
     return out;
 }
 
@@ -23,15 +32,30 @@ ini_t ini_parse_str(arena_t *arena, strview_t str, iniopt_t *opt) {
         .text = str,
         .tables = NULL,
     };
-    ini__parse(arena, &out, opt);
+    TRACE_SCOPE("ini_parse_str") {
+        ini__parse(arena, &out, opt);
+    }
     return out;
 }
 
+ini_t ini_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map, iniopt_t *opt) {
+    *out_map = os_file_map(filename, OS_MAP_SEQUENTIAL | OS_MAP_WILLNEED);
+    ini_t ini = ini_parse_str(arena, out_map->text, opt);
+    if (!ini_is_valid(&ini)) {
+        os_file_unmap(out_map);
+    }
+    return ini;
+}
+
 bool ini_is_valid(ini_t *ini) {
     return ini && !strv_is_empty(ini->text);
 }
 
 initable_t *ini_get_table(ini_t *ini, strview_t name) {
+    if (ini && ini->index) {
+        return ini__index_get(ini->index, name);
+    }
+
     initable_t *t = ini ? ini->tables : NULL;
     while (t) {
         if (strv_equals(t->name, name)) {
@@ -43,6 +67,10 @@ initable_t *ini_get_table(ini_t *ini, strview_t name) {
 }
 
 inivalue_t *ini_get(initable_t *table, strview_t key) {
+    if (table && table->index) {
+        return ini__index_get(table->index, key);
+    }
+
     inivalue_t *v = table ? table->values : NULL;
     while (v) {
         if (strv_equals(v->key, key)) {
@@ -57,38 +85,42 @@ iniarray_t ini_as_arr(arena_t *arena, inivalue_t *value, char delim) {
     strview_t v = value ? value->value : STRV_EMPTY;
     if (!delim) delim = ' ';
 
-    strview_t *beg = (strview_t *)arena->cur;
-    usize count = 0;
+    strv_array_t split = strv_split_all(arena, v, strv(&delim, 1));
 
-    usize start = 0;
-    for (usize i = 0; i < v.len; ++i) {
-        if (v.buf[i] == delim) {
-            strview_t arrval = strv_trim(strv_sub(v, start, i));
-            if (!strv_is_empty(arrval)) {
-                strview_t *newval = alloc(arena, strview_t);
-                *newval = arrval;
-                ++count;
-            }
-            start = i + 1;
+    // trim the values and remove the empty ones in place
+    usize count = 0;
+    for (usize i = 0; i < split.count; ++i) {
+        strview_t arrval = strv_trim(split.items[i]);
+        if (!strv_is_empty(arrval)) {
+            split.items[count++] = arrval;
         }
     }
 
-    strview_t last = strv_trim(strv_sub(v, start, SIZE_MAX));
-    if (!strv_is_empty(last)) {
-        strview_t *newval = alloc(arena, strview_t);
-        *newval = last;
-        ++count;
-    }
-
     return (iniarray_t){
-        .values = beg,
+        .values = split.items,
         .count = count,
     };
 }
 
+// text from ini_parse_map isn't NUL terminated and strtoull/strtod would read
+// past the end of the mapping, so numbers are converted from a copy on the
+// stack. anything that doesn't fit is not a number
+#define INI__NUM_MAX 64
+
+instream_t ini__num_init(strview_t value, char buf[INI__NUM_MAX]) {
+    // values keep the spaces that were before a comment
+    value = strv_trim_right(value);
+    if (value.len >= INI__NUM_MAX) {
+        return istr_init(STRV_EMPTY);
+    }
+    memcpy(buf, value.buf, value.len);
+    buf[value.len] = '\0';
+    return istr_init(strv_init_len(buf, value.len));
+}
+
 u64 ini_as_uint(inivalue_t *value) {
-    strview_t v = value ? value->value : STRV_EMPTY;
-    instream_t in = istr_init(v);
+    char buf[INI__NUM_MAX];
+    instream_t in = ini__num_init(value ? value->value : STRV_EMPTY, buf);
     u64 out = 0;
     if (!istr_get_u64(&in, &out)) {
         out = 0;
@@ -97,8 +129,8 @@ u64 ini_as_uint(inivalue_t *value) {
 }
 
 i64 ini_as_int(inivalue_t *value) {
-    strview_t v = value ? value->value : STRV_EMPTY;
-    instream_t in = istr_init(v);
+    char buf[INI__NUM_MAX];
+    instream_t in = ini__num_init(value ? value->value : STRV_EMPTY, buf);
     i64 out = 0;
     if (!istr_get_i64(&in, &out)) {
         out = 0;
@@ -107,8 +139,8 @@ i64 ini_as_int(inivalue_t *value) {
 }
 
 double ini_as_num(inivalue_t *value) {
-    strview_t v = value ? value->value : STRV_EMPTY;
-    instream_t in = istr_init(v);
+    char buf[INI__NUM_MAX];
+    instream_t in = ini__num_init(value ? value->value : STRV_EMPTY, buf);
     double out = 0;
     if (!istr_get_num(&in, &out)) {
         out = 0;
@@ -126,6 +158,405 @@ bool ini_as_bool(inivalue_t *value) {
     return out;
 }
 
+typedef struct ini__field_t ini__field_t;
+struct ini__field_t {
+    bool used;
+    u64 hash;
+    inibind_t bind;
+};
+
+struct inischema_t {
+    ini__field_t *fields;
+    u32 mask;
+    u64 root_hash;
+};
+
+// mixes in the table so the same key in different tables lands somewhere else
+u64 ini__field_hash(u64 table_hash, strview_t key) {
+    return (table_hash * 0x100000001b3ull) ^ strv_hash(key);
+}
+
+ini__field_t *ini__schema_find(inischema_t *schema, strview_t table, strview_t key, u64 hash) {
+    u32 i = (u32)hash & schema->mask;
+    while (true) {
+        ini__field_t *field = &schema->fields[i];
+        if (!field->used) {
+            return field;
+        }
+        if (field->hash == hash && strv_equals(field->bind.key, key) && strv_equals(field->bind.table, table)) {
+            return field;
+        }
+        i = (i + 1) & schema->mask;
+    }
+}
+
+inischema_t *ini_schema_compile(arena_t *arena, const inibind_t *binds, usize count) {
+    u32 size = 8;
+    // at most half full
+    while (size < count * 2) {
+        size <<= 1;
+    }
+
+    inischema_t *schema = alloc(arena, inischema_t);
+    schema->fields = alloc(arena, ini__field_t, size);
+    schema->mask = size - 1;
+    schema->root_hash = strv_hash(INI_ROOT);
+
+    for (usize i = 0; i < count; ++i) {
+        inibind_t bind = binds[i];
+        if (strv_is_empty(bind.table)) {
+            bind.table = INI_ROOT;
+        }
+
+        u64 hash = ini__field_hash(strv_hash(bind.table), bind.key);
+        ini__field_t *field = ini__schema_find(schema, bind.table, bind.key, hash);
+        if (field->used) {
+            warn("%v.%v is bound twice, only the first one is used", bind.table, bind.key);
+            continue;
+        }
+
+        *field = (ini__field_t){
+            .used = true,
+            .hash = hash,
+            .bind = bind,
+        };
+    }
+
+    return schema;
+}
+
+usize ini_bind_str(inischema_t *schema, strview_t str, void *out, iniopt_t *opt) {
+    usize written = 0;
+    if (!schema || !out) {
+        return written;
+    }
+    TRACE_SCOPE("ini_bind_str") {
+        written = ini__bind(schema, str, out, opt);
+    }
+    return written;
+}
+
+usize ini_bind(arena_t *arena, inischema_t *schema, strview_t filename, void *out, iniopt_t *opt) {
+    str_t data = os_file_read_all_str(arena, filename);
+    return ini_bind_str(schema, strv(data), out, opt);
+}
+
+void ini__write_values(outstream_t *out, initable_t *table, char divider) {
+    for_each (val, table->values) {
+        // values keep the spaces that were before a comment
+        ostr_print(out, "%v %c %v\n", val->key, divider, strv_trim_right(val->value));
+    }
+}
+
+void ini_write(outstream_t *out, ini_t *ini, iniopt_t *opt) {
+    if (!ini) {
+        return;
+    }
+
+    iniopt_t opts = ini__get_options(opt);
+    bool first = true;
+
+    // values outside of a table have to come before the first one
+    for_each (table, ini->tables) {
+        if (strv_equals(table->name, INI_ROOT) && table->values) {
+            ini__write_values(out, table, opts.key_value_divider);
+            first = false;
+        }
+    }
+
+    for_each (table, ini->tables) {
+        if (strv_equals(table->name, INI_ROOT)) {
+            continue;
+        }
+        if (!first) {
+            ostr_putc(out, '\n');
+        }
+        ostr_print(out, "[%v]\n", table->name);
+        ini__write_values(out, table, opts.key_value_divider);
+        first = false;
+    }
+}
+
+bool ini_write_file(arena_t scratch, strview_t filename, ini_t *ini, iniopt_t *opt) {
+    outstream_t out = ostr_init(&scratch);
+    ini_write(&out, ini, opt);
+    return os_file_write_all_str(filename, ostr_as_view(&out));
+}
+
+struct inipatch_t {
+    strview_t table;
+    strview_t key;
+    strview_t value;
+    // bytes [offset, offset + len) of the text are replaced, len is 0 for new keys
+    usize offset;
+    usize len;
+    bool new_key;
+    bool new_table;
+    // the line it goes after doesn't end with a new line
+    bool needs_newline;
+    // empty value right after the divider
+    bool needs_space;
+    inipatch_t *next;
+};
+
+iniedit_t ini_edit_init(arena_t *arena, strview_t text, iniopt_t *opt) {
+    iniedit_t edit = {
+        .arena = arena,
+        .options = ini__get_options(opt),
+    };
+    edit.options.hash_index = true;
+    edit.ini = ini_parse_str(arena, text, &edit.options);
+    return edit;
+}
+
+iniedit_t ini_edit_open(arena_t *arena, strview_t filename, iniopt_t *opt) {
+    str_t data = os_file_read_all_str(arena, filename);
+    return ini_edit_init(arena, strv(data), opt);
+}
+
+// offset right after the line that contains pos
+usize ini__edit_line_end(strview_t text, usize pos, bool *needs_newline) {
+    usize newline = strv_find(text, '\n', pos);
+    if (newline == STR_NONE) {
+        *needs_newline = true;
+        return text.len;
+    }
+    return newline + 1;
+}
+
+void ini__edit_find(iniedit_t *edit, inipatch_t *patch) {
+    strview_t text = edit->ini.text;
+    initable_t *table = ini_get_table(&edit->ini, patch->table);
+    inivalue_t *value = table ? ini_get(table, patch->key) : NULL;
+
+    if (value && value->value.len) {
+        // without the spaces that were left before a comment
+        patch->offset = value->value.buf - text.buf;
+        patch->len = strv_trim_right(value->value).len;
+    }
+    else if (value) {
+        // empty values go after the divider and its space
+        usize key_end = value->key.buf + value->key.len - text.buf;
+        usize divider = strv_find(text, edit->options.key_value_divider, key_end);
+        patch->offset = divider + 1;
+        if (patch->offset < text.len && text.buf[patch->offset] == ' ') {
+            patch->offset++;
+        }
+        else {
+            patch->needs_space = true;
+        }
+    }
+    else if (table && table->tail) {
+        inivalue_t *last = table->tail;
+        patch->new_key = true;
+        patch->offset = ini__edit_line_end(text, last->key.buf + last->key.len - text.buf, &patch->needs_newline);
+    }
+    else if (table && !strv_equals(table->name, INI_ROOT)) {
+        patch->new_key = true;
+        patch->offset = ini__edit_line_end(text, table->name.buf + table->name.len - text.buf, &patch->needs_newline);
+    }
+    else if (table) {
+        // empty root, the top of the file is outside of any table
+        patch->new_key = true;
+        patch->offset = 0;
+    }
+    else {
+        patch->new_table = true;
+        patch->offset = text.len;
+    }
+}
+
+// patches at the same offset go in this order: a value that is replaced in
+// place (e.g. an empty one at the end of the file), then new keys, then new tables
+int ini__patch_rank(inipatch_t *patch) {
+    return patch->new_table ? 2 : patch->new_key ? 1 : 0;
+}
+
+bool ini_edit_set(iniedit_t *edit, strview_t table, strview_t key, strview_t value) {
+    if (!edit || !edit->arena) {
+        return false;
+    }
+
+    // the parser trims keys, " k " is the same key as "k"
+    key = strv_trim(key);
+
+    // anything that would end the line, the value or the name early. a key
+    // that starts like a table header or a comment would be read as one
+    char key_stop[] = { '\n', '\r', edit->options.key_value_divider };
+    bool valid =
+        strv_find_either(table, strv("\n\r]"), 0) == STR_NONE &&
+        !strv_is_empty(key) &&
+        key.buf[0] != '[' &&
+        strv_find(edit->options.comment_vals, key.buf[0], 0) == STR_NONE &&
+        strv_find_either(key, strv_init_len(key_stop, sizeof(key_stop)), 0) == STR_NONE &&
+        strv_find_either(value, strv("\n\r"), 0) == STR_NONE &&
+        strv_find_either(value, edit->options.comment_vals, 0) == STR_NONE;
+
+    if (!valid) {
+        err("can't write [%v] %v = \"%v\", it wouldn't parse back the same", table, key, value);
+        return false;
+    }
+
+    if (strv_is_empty(table)) {
+        table = INI_ROOT;
+    }
+
+    // the same key again only changes the value
+    for_each (patch, edit->patches) {
+        if (strv_equals(patch->table, table) && strv_equals(patch->key, key)) {
+            patch->value = strv(str(edit->arena, value));
+            return true;
+        }
+    }
+
+    inipatch_t *patch = alloc(edit->arena, inipatch_t);
+    patch->table = strv(str(edit->arena, table));
+    patch->key = strv(str(edit->arena, key));
+    patch->value = strv(str(edit->arena, value));
+
+    ini__edit_find(edit, patch);
+
+    // keep it sorted by offset, in the order they were set. new tables are all
+    // at the end of the text, after everything else, with their keys together
+    inipatch_t *prev = NULL;
+    for_each (it, edit->patches) {
+        if (it->offset > patch->offset) break;
+        if (it->offset == patch->offset && ini__patch_rank(it) > ini__patch_rank(patch)) break;
+        if (patch->new_table && it->new_table && prev && prev->new_table &&
+            strv_equals(prev->table, patch->table) && !strv_equals(it->table, patch->table)) {
+            break;
+        }
+        prev = it;
+    }
+
+    if (prev) {
+        patch->next = prev->next;
+        prev->next = patch;
+    }
+    else {
+        patch->next = edit->patches;
+        edit->patches = patch;
+    }
+
+    return true;
+}
+
+str_t ini_edit_to_str(arena_t *arena, iniedit_t *edit) {
+    outstream_t out = ostr_init(arena);
+    strview_t text = edit->ini.text;
+    char divider = edit->options.key_value_divider;
+    usize cursor = 0;
+    inipatch_t *prev = NULL;
+
+    for_each (patch, edit->patches) {
+        ostr_puts(&out, strv_sub(text, cursor, patch->offset));
+        cursor = patch->offset + patch->len;
+
+        if (patch->needs_newline && ostr_tell(&out) && ostr_back(&out) != '\n') {
+            ostr_putc(&out, '\n');
+        }
+
+        if (patch->new_table && !(prev && prev->new_table && strv_equals(prev->table, patch->table))) {
+            // the previous table only ends at an empty line
+            strview_t written = ostr_as_view(&out);
+            if (written.len && !strv_ends_with(written, '\n')) {
+                ostr_putc(&out, '\n');
+                written = ostr_as_view(&out);
+            }
+            usize line_start = written.len ? written.len - 1 : 0;
+            while (line_start > 0 && written.buf[line_start - 1] != '\n') {
+                line_start--;
+            }
+            strview_t last_line = strv_sub(written, line_start, written.len);
+            if (!strv_is_empty(strv_trim(last_line))) {
+                ostr_putc(&out, '\n');
+            }
+            ostr_print(&out, "[%v]\n", patch->table);
+        }
+
+        if (patch->new_key || patch->new_table) {
+            ostr_print(&out, "%v %c %v\n", patch->key, divider, patch->value);
+        }
+        else {
+            if (patch->needs_space) {
+                ostr_putc(&out, ' ');
+            }
+            ostr_puts(&out, patch->value);
+        }
+
+        prev = patch;
+    }
+
+    ostr_puts(&out, strv_sub(text, cursor, text.len));
+
+    return ostr_to_str(&out);
+}
+
+bool ini_edit_save(iniedit_t *edit, strview_t filename) {
+    if (!edit || !edit->patches) {
+        return true;
+    }
+
+    strview_t old_text = edit->ini.text;
+    str_t text = ini_edit_to_str(edit->arena, edit);
+
+    // opening for read and write creates the file if it's missing
+    if (!os_file_exists(filename)) {
+        err("could not find file %v", filename);
+        return false;
+    }
+
+    oshandle_t fp = os_file_open(filename, FILEMODE_READ | FILEMODE_WRITE);
+    if (!os_handle_valid(fp)) {
+        err("could not open file %v", filename);
+        return false;
+    }
+
+    // only the changes are written, the rest has to be what we parsed
+    if (os_file_size(fp) != old_text.len) {
+        err("%v was changed since it was read, not saving", filename);
+        os_file_close(fp);
+        return false;
+    }
+
+    bool in_place = true;
+    for_each (patch, edit->patches) {
+        if (patch->new_key || patch->new_table || patch->needs_space || patch->value.len != patch->len) {
+            in_place = false;
+            break;
+        }
+    }
+
+    bool success = true;
+
+    if (in_place) {
+        for_each (patch, edit->patches) {
+            success &= os_file_write_at(fp, patch->value.buf, patch->value.len, patch->offset) == patch->value.len;
+        }
+    }
+    else {
+        // everything before the first change is already there
+        usize first = edit->patches->offset;
+        usize len = text.len - first;
+        success = os_file_write_at(fp, text.buf + first, len, first) == len;
+        if (success && text.len < old_text.len) {
+            success = os_file_set_size(fp, text.len);
+        }
+    }
+
+    os_file_close(fp);
+
+    if (!success) {
+        err("failed to write the changes to %v", filename);
+        return false;
+    }
+
+    edit->ini = ini_parse_str(edit->arena, strv(text), &edit->options);
+    edit->patches = NULL;
+
+    return true;
+}
+
 ///// ini-private ////////////////////////////////////
 
 iniopt_t ini__get_options(const iniopt_t *options) {
@@ -140,18 +571,90 @@ iniopt_t ini__get_options(const iniopt_t *options) {
         SETOPT(key_value_divider);
         SETOPT(merge_duplicate_keys);
         SETOPT(merge_duplicate_tables);
+        SETOPT(hash_index);
         out.comment_vals = strv_is_empty(options->comment_vals) ? out.comment_vals : options->comment_vals;
     }
 
 #undef SETOPT
 
+    if (out.merge_duplicate_keys || out.merge_duplicate_tables) {
+        out.hash_index = true;
+    }
+
     return out;
 }
 
+#define INI__INDEX_MIN_SIZE (8)
+
+typedef struct ini__slot_t ini__slot_t;
+struct ini__slot_t {
+    u64 hash;
+    strview_t key;
+    void *item;
+};
+
+struct iniindex_t {
+    ini__slot_t *slots;
+    u32 mask;
+    u32 count;
+};
+
+ini__slot_t *ini__index_find(iniindex_t *index, strview_t key, u64 hash) {
+    u32 i = (u32)hash & index->mask;
+    while (true) {
+        ini__slot_t *slot = &index->slots[i];
+        if (!slot->item || (slot->hash == hash && strv_equals(slot->key, key))) {
+            return slot;
+        }
+        i = (i + 1) & index->mask;
+    }
+}
+
+void *ini__index_get(iniindex_t *index, strview_t key) {
+    return ini__index_find(index, key, strv_hash(key))->item;
+}
+
+// only adds the item if the key isn't there yet, so lookups keep returning
+// the first one like the linear search does
+void ini__index_add(arena_t *arena, iniindex_t **pindex, strview_t key, void *item) {
+    iniindex_t *index = *pindex;
+
+    if (!index) {
+        index = alloc(arena, iniindex_t);
+        index->slots = alloc(arena, ini__slot_t, INI__INDEX_MIN_SIZE);
+        index->mask = INI__INDEX_MIN_SIZE - 1;
+        *pindex = index;
+    }
+
+    // keep it at most 3/4 full, the old slots are left in the arena
+    if ((index->count + 1) * 4 > (index->mask + 1) * 3) {
+        ini__slot_t *old = index->slots;
+        u32 old_size = index->mask + 1;
+
+        index->slots = alloc(arena, ini__slot_t, old_size * 2);
+        index->mask = old_size * 2 - 1;
+
+        for (u32 i = 0; i < old_size; ++i) {
+            if (old[i].item) {
+                *ini__index_find(index, old[i].key, old[i].hash) = old[i];
+            }
+        }
+    }
+
+    u64 hash = strv_hash(key);
+    ini__slot_t *slot = ini__index_find(index, key, hash);
+    if (!slot->item) {
+        *slot = (ini__slot_t){
+            .hash = hash,
+            .key = key,
+            .item = item,
+        };
+        index->count++;
+    }
+}
 
-void ini__add_value(arena_t *arena, initable_t *table, instream_t *in, iniopt_t *opts) {
-    assert(table);
 
+void ini__read_value(instream_t *in, const iniopt_t *opts, strview_t *out_key, strview_t *out_value) {
     strview_t key = strv_trim(istr_get_view(in, opts->key_value_divider));
     istr_skip(in, 1);
 
@@ -161,16 +664,21 @@ void ini__add_value(arena_t *arena, initable_t *table, instream_t *in, iniopt_t
         value = strv_sub(value, 0, comment_pos);
     }
     istr_skip(in, 1);
+
+    *out_key = key;
+    *out_value = value;
+}
+
+void ini__add_value(arena_t *arena, initable_t *table, instream_t *in, iniopt_t *opts) {
+    assert(table);
+
+    strview_t key, value;
+    ini__read_value(in, opts, &key, &value);
+
     inivalue_t *newval = NULL;
     
     if (opts->merge_duplicate_keys) {
-        newval = table->values;
-        while (newval) {
-            if (strv_equals(newval->key, key)) {
-                break;
-            }
-            newval = newval->next;
-        }
+        newval = ini_get(table, key);
     }
 
     if (newval) {
@@ -189,6 +697,10 @@ void ini__add_value(arena_t *arena, initable_t *table, instream_t *in, iniopt_t
         }
 
         table->tail = newval;
+
+        if (opts->hash_index) {
+            ini__index_add(arena, &table->index, key, newval);
+        }
     }
 }
 
@@ -199,13 +711,7 @@ void ini__add_table(arena_t *arena, ini_t *ctx, instream_t *in, iniopt_t *option
     initable_t *table = NULL;
 
     if (options->merge_duplicate_tables) {
-        table = ctx->tables;
-        while (table) {
-            if (strv_equals(table->name, name)) {
-                break;
-            }
-            table = table->next;
-        }
+        table = ini_get_table(ctx, name);
     }
 
     if (!table) {
@@ -221,6 +727,10 @@ void ini__add_table(arena_t *arena, ini_t *ctx, instream_t *in, iniopt_t *option
         }
 
         ctx->tail = table;
+
+        if (options->hash_index) {
+            ini__index_add(arena, &ctx->index, name, table);
+        }
     }
 
     istr_ignore_and_skip(in, '\n');
@@ -248,6 +758,10 @@ void ini__parse(arena_t *arena, ini_t *ini, const iniopt_t *options) {
     ini->tables = root;
     ini->tail = root;
 
+    if (opts.hash_index) {
+        ini__index_add(arena, &ini->index, root->name, root);
+    }
+
     instream_t in = istr_init(ini->text);
 
     while (!istr_is_finished(&in)) {
@@ -267,16 +781,160 @@ void ini__parse(arena_t *arena, ini_t *ini, const iniopt_t *options) {
     }
 }
 
+// istr_get_u64/i64 reject ULLONG_MAX, INT64_MIN and INT64_MAX, here they are
+// valid values and errno is what says it overflowed. in has to come from
+// ini__num_init, strtoull needs the NUL at the end
+bool ini__get_u64(instream_t *in, u64 *out) {
+    if (istr_is_finished(in)) return false;
+    char *end = NULL;
+    errno = 0;
+    *out = strtoull(in->cur, &end, 0);
+    if (end == in->cur || errno == ERANGE) return false;
+    in->cur = end;
+    return true;
+}
+
+bool ini__get_i64(instream_t *in, i64 *out) {
+    if (istr_is_finished(in)) return false;
+    char *end = NULL;
+    errno = 0;
+    *out = strtoll(in->cur, &end, 0);
+    if (end == in->cur || errno == ERANGE) return false;
+    in->cur = end;
+    return true;
+}
+
+bool ini__bind_value(inischema_t *schema, strview_t table, u64 table_hash, strview_t key, strview_t value, void *out) {
+    ini__field_t *field = ini__schema_find(schema, table, key, ini__field_hash(table_hash, key));
+    if (!field->used) {
+        return false;
+    }
+
+    u8 *dst = (u8 *)out + field->bind.offset;
+
+    if (field->bind.type == INI_TYPE_STR) {
+        *(strview_t *)dst = value;
+        return true;
+    }
+
+    char buf[INI__NUM_MAX];
+    instream_t in = ini__num_init(value, buf);
+    // strtoull happily wraps negative numbers around
+    bool negative = istr_peek(&in) == '-';
+    bool success = false;
+
+    // converted into a temporary first so a bad value leaves the field alone
+    union { bool b; u64 u; i64 i; double n; } v = {0};
+
+    switch (field->bind.type) {
+        case INI_TYPE_BOOL: success = istr_get_bool(&in, &v.b); break;
+        case INI_TYPE_U32:  success = !negative && ini__get_u64(&in, &v.u) && v.u <= UINT32_MAX; break;
+        case INI_TYPE_U64:  success = !negative && ini__get_u64(&in, &v.u); break;
+        case INI_TYPE_I32:  success = ini__get_i64(&in, &v.i) && v.i >= INT32_MIN && v.i <= INT32_MAX; break;
+        case INI_TYPE_I64:  success = ini__get_i64(&in, &v.i); break;
+        case INI_TYPE_NUM:  success = istr_get_num(&in, &v.n); break;
+        default: break;
+    }
+
+    // the whole value has to be used, e.g. "80abc" or "trueish" are not valid
+    if (!success || !istr_is_finished(&in)) {
+        warn("couldn't convert %v.%v: \"%v\"", table, key, value);
+        return false;
+    }
+
+    switch (field->bind.type) {
+        case INI_TYPE_BOOL: *(bool *)dst   = v.b;      break;
+        case INI_TYPE_U32:  *(u32 *)dst    = (u32)v.u; break;
+        case INI_TYPE_U64:  *(u64 *)dst    = v.u;      break;
+        case INI_TYPE_I32:  *(i32 *)dst    = (i32)v.i; break;
+        case INI_TYPE_I64:  *(i64 *)dst    = v.i;      break;
+        case INI_TYPE_NUM:  *(double *)dst = v.n;      break;
+        default: break;
+    }
+
+    return true;
+}
+
+// same rules as ini__add_table: the table ends at the first empty line
+usize ini__bind_table(inischema_t *schema, instream_t *in, const iniopt_t *opts, void *out) {
+    istr_skip(in, 1); // skip [
+    strview_t name = istr_get_view(in, ']');
+    istr_skip(in, 1); // skip ]
+    u64 hash = strv_hash(name);
+    usize written = 0;
+
+    istr_ignore_and_skip(in, '\n');
+    while (!istr_is_finished(in)) {
+        switch (istr_peek(in)) {
+            case '\n': // fallthrough
+            case '\r':
+                return written;
+            case '#':  // fallthrough
+            case ';':
+                istr_ignore_and_skip(in, '\n');
+                break;
+            default:
+            {
+                strview_t key, value;
+                ini__read_value(in, opts, &key, &value);
+                written += ini__bind_value(schema, name, hash, key, value, out);
+                break;
+            }
+        }
+    }
+
+    return written;
+}
+
+usize ini__bind(inischema_t *schema, strview_t text, void *out, const iniopt_t *options) {
+    iniopt_t opts = ini__get_options(options);
+    instream_t in = istr_init(text);
+    usize written = 0;
+
+    while (!istr_is_finished(&in)) {
+        istr_skip_whitespace(&in);
+        switch (istr_peek(&in)) {
+            case '[':
+                written += ini__bind_table(schema, &in, &opts, out);
+                break;
+            case '#': // fallthrough
+            case ';':
+                istr_ignore_and_skip(&in, '\n');
+                break;
+            default:
+            {
+                strview_t key, value;
+                ini__read_value(&in, &opts, &key, &value);
+                written += ini__bind_value(schema, INI_ROOT, schema->root_hash, key, value, out);
+                break;
+            }
+        }
+    }
+
+    return written;
+}
+
 // == JSON ===========================================
 
 bool json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags, json_t **out);
 
 json_t *json_parse(arena_t *arena, strview_t filename, jsonflags_e flags) {
-    str_t data = os_file_read_all_str(arena, filename);
-    return json_parse_str(arena, strv(data), flags);
+    json_t *root = NULL;
+    TRACE_SCOPE("json_parse") {
+        str_t data = os_file_read_all_str(arena, filename);
+        root = json_parse_str(arena, strv(data), flags);
+    }
+    return root;
 }
 
 json_t *json_parse_str(arena_t *arena, strview_t str, jsonflags_e flags) {
+    if ((flags & JSON_VALIDATE_UTF8) && !strv_is_utf8(str)) {
+        err("json is not valid utf8");
+        return NULL;
+    }
+
+    TRACE_BEGIN("json_parse_str");
+
     arena_t before = *arena;
 
     json_t *root = alloc(arena, json_t);
@@ -287,9 +945,19 @@ json_t *json_parse_str(arena_t *arena, strview_t str, jsonflags_e flags) {
     if (!json__parse_obj(arena, &in, flags, &root->object)) {
         // reset arena
         *arena = before;
-        return NULL;
+        root = NULL;
     }
 
+    TRACE_END();
+    return root;
+}
+
+json_t *json_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map, jsonflags_e flags) {
+    *out_map = os_file_map(filename, OS_MAP_SEQUENTIAL | OS_MAP_WILLNEED);
+    json_t *root = json_parse_str(arena, out_map->text, flags);
+    if (!root) {
+        os_file_unmap(out_map);
+    }
     return root;
 }
 
@@ -370,6 +1038,28 @@ bool json__is_value_finished(instream_t *in) {
     return false;
 }
 
+// same problem as ini__num_init, json_parse_map text isn't NUL terminated
+bool json__parse_num(instream_t *in, double *out) {
+    char buf[64];
+    usize len = 0;
+    usize rem = istr_remaining(in);
+    while (len < rem && len < (sizeof(buf) - 1)) {
+        char c = in->cur[len];
+        if (!char_is_num(c) && c != '-' && c != '+' && c != '.' && c != 'e' && c != 'E') {
+            break;
+        }
+        buf[len++] = c;
+    }
+    buf[len] = '\0';
+
+    instream_t num = istr_init(strv_init_len(buf, len));
+    if (!istr_get_num(&num, out)) {
+        return false;
+    }
+    istr_skip(in, istr_tell(&num));
+    return true;
+}
+
 bool json__parse_null(instream_t *in) {
     strview_t null_view = istr_get_view_len(in, 4);
     bool is_valid = true;
@@ -419,7 +1109,7 @@ bool json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags, json_t
                 // trailing comma
                 if (istr_peek(in) == ']') {
                     if (flags & JSON_NO_TRAILING_COMMAS) {
-                        err("trailing comma in array at at %zu: (%c)(%d)", istr_tell(in), *in->cur, *in->cur);
+                        err("trailing comma in array at at %zu: (%c)(%d)", istr_tell(in), istr_peek(in), istr_peek(in));
                         goto fail;
                     }
                     else {
@@ -438,7 +1128,7 @@ bool json__parse_array(arena_t *arena, instream_t *in, jsonflags_e flags, json_t
             }
             default:
                 istr_rewind_n(in, 1);
-                err("unknown char after array at %zu: (%c)(%d)", istr_tell(in), *in->cur, *in->cur);
+                err("unknown char after array at %zu: (%c)(%d)", istr_tell(in), istr_peek(in), istr_peek(in));
                 goto fail;
         }
     }
@@ -550,7 +1240,7 @@ bool json__parse_obj(arena_t *arena, instream_t *in, jsonflags_e flags, json_t *
             }
             default:
                 istr_rewind_n(in, 1);
-                err("unknown char after object at %zu: (%c)(%d)", istr_tell(in), *in->cur, *in->cur);
+                err("unknown char after object at %zu: (%c)(%d)", istr_tell(in), istr_peek(in), istr_peek(in));
                 goto fail;
         }
     }
@@ -611,7 +1301,7 @@ bool json__parse_value(arena_t *arena, instream_t *in, jsonflags_e flags, json_t
             break;
         // number
         default:
-            if (!istr_get_num(in, &val->number)) {
+            if (!json__parse_num(in, &val->number)) {
                 goto fail;
             }
             val->type = JSON_NUMBER;
@@ -707,8 +1397,12 @@ void json__pretty_print_value(json_t *value, int indent, const json_pretty_opts_
 xmltag_t *xml__parse_tag(arena_t *arena, instream_t *in);
 
 xml_t xml_parse(arena_t *arena, strview_t filename) {
-    str_t str = os_file_read_all_str(arena, filename);
-    return xml_parse_str(arena, strv(str));
+    xml_t out = {0};
+    TRACE_SCOPE("xml_parse") {
+        str_t str = os_file_read_all_str(arena, filename);
+        out = xml_parse_str(arena, strv(str));
+    }
+    return out;
 }
 
 xml_t xml_parse_str(arena_t *arena, strview_t xmlstr) {
@@ -719,18 +1413,30 @@ xml_t xml_parse_str(arena_t *arena, strview_t xmlstr) {
     
     instream_t in = istr_init(xmlstr);
 
-    while (!istr_is_finished(&in)) {
-        xmltag_t *tag = xml__parse_tag(arena, &in);
+    TRACE_SCOPE("xml_parse_str") {
+        while (!istr_is_finished(&in)) {
+            xmltag_t *tag = xml__parse_tag(arena, &in);
 
-        if (out.tail) out.tail->next = tag;
-        else          out.root->child = tag;
+            if (out.tail) out.tail->next = tag;
+            else          out.root->child = tag;
 
-        out.tail = tag;
+            out.tail = tag;
+        }
     }
 
     return out;
 }
 
+xml_t xml_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map) {
+    *out_map = os_file_map(filename, OS_MAP_SEQUENTIAL | OS_MAP_WILLNEED);
+    xml_t xml = xml_parse_str(arena, out_map->text);
+    // the xml parser has no errors, only an empty (or unmappable) file fails
+    if (strv_is_empty(xml.text)) {
+        os_file_unmap(out_map);
+    }
+    return xml;
+}
+
 xmltag_t *xml_get_tag(xmltag_t *parent, strview_t key, bool recursive) {
     xmltag_t *t = parent ? parent->child : NULL;
     while (t) {
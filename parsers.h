@@ -7,6 +7,10 @@
 
 // == INI ============================================
 
+// hash index of the tables or of the keys in a table, only built with
+// iniopt_t.hash_index (or the merge options). the lists stay the same
+typedef struct iniindex_t iniindex_t;
+
 typedef struct inivalue_t inivalue_t;
 struct inivalue_t {
     strview_t key;
@@ -20,6 +24,7 @@ struct initable_t {
     inivalue_t *values;
     inivalue_t *tail;
     initable_t *next;
+    iniindex_t *index;
 };
 
 typedef struct ini_t ini_t;
@@ -27,12 +32,14 @@ struct ini_t {
     strview_t text;
     initable_t *tables;
     initable_t *tail;
+    iniindex_t *index;
 };
 
 typedef struct iniopt_t iniopt_t;
 struct iniopt_t {
     bool merge_duplicate_tables; // default false
     bool merge_duplicate_keys;   // default false
+    bool hash_index;             // default false, makes ini_get_table and ini_get O(1), always on when merging
     char key_value_divider;      // default =
     strview_t comment_vals;      // default ;#
 };
@@ -48,6 +55,10 @@ struct iniarray_t {
 ini_t ini_parse(arena_t *arena, strview_t filename, iniopt_t *opt);
 ini_t ini_parse_fp(arena_t *arena, oshandle_t file, iniopt_t *opt);
 ini_t ini_parse_str(arena_t *arena, strview_t str, iniopt_t *opt);
+// maps the file instead of reading it into the arena, the result points inside
+// the mapping so only call os_file_unmap on out_map once you're done with it.
+// if parsing fails the file is unmapped already and out_map is zeroed
+ini_t ini_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map, iniopt_t *opt);
 
 bool ini_is_valid(ini_t *ini);
 
@@ -55,11 +66,93 @@ initable_t *ini_get_table(ini_t *ini, strview_t name);
 inivalue_t *ini_get(initable_t *table, strview_t key);
 
 iniarray_t ini_as_arr(arena_t *arena, inivalue_t *value, char delim);
+// numbers are converted from a copy so they work on mapped text, values of 64
+// characters or more return 0
 u64 ini_as_uint(inivalue_t *value);
 i64 ini_as_int(inivalue_t *value);
 double ini_as_num(inivalue_t *value);
 bool ini_as_bool(inivalue_t *value);
 
+// schema binding: parses the ini straight into a struct, without building an
+// ini_t. the bindings are hashed once by ini_schema_compile, then every key in
+// the file is looked up once and converted right away
+//
+//     inibind_t binds[] = {
+//         INI_BIND(config_t, "server", "port",  INI_TYPE_U32,  port),
+//         INI_BIND(config_t, "server", "debug", INI_TYPE_BOOL, debug),
+//     };
+//     inischema_t *schema = ini_schema_compile(&arena, binds, arrlen(binds));
+//     config_t config = { .port = 8080 }; // keys that are missing keep their value
+//     ini_bind_str(schema, text, &config, NULL);
+
+typedef enum initype_e {
+    INI_TYPE_STR,  // strview_t, points inside the text
+    INI_TYPE_BOOL, // bool
+    INI_TYPE_U32,  // u32
+    INI_TYPE_U64,  // u64
+    INI_TYPE_I32,  // i32
+    INI_TYPE_I64,  // i64
+    INI_TYPE_NUM,  // double
+} initype_e;
+
+typedef struct inibind_t inibind_t;
+struct inibind_t {
+    strview_t table; // INI_ROOT or empty for the keys outside of any table
+    strview_t key;
+    initype_e type;
+    usize offset;
+};
+
+#define INI_BIND(T, table, key, type, member) { strv(table), strv(key), type, offsetof(T, member) }
+
+// read only once compiled, it can be shared between threads
+typedef struct inischema_t inischema_t;
+
+inischema_t *ini_schema_compile(arena_t *arena, const inibind_t *binds, usize count);
+// returns how many values were written into out, a key that is repeated is
+// written (and counted) every time. values that fail to convert (out of range
+// for the field, or with anything left after the number/bool) are skipped with
+// a warning and leave the field as it was
+usize ini_bind_str(inischema_t *schema, strview_t str, void *out, iniopt_t *opt);
+// the strings point inside the file, which is read into the arena
+usize ini_bind(arena_t *arena, inischema_t *schema, strview_t filename, void *out, iniopt_t *opt);
+
+// writes the values out as "key = value" lines, the root values first and an
+// empty line between tables (that's where a table ends when parsing). comments
+// and layout are not kept, use iniedit_t for that. only the divider from opt is
+// used, values can't contain new lines or comment characters
+void ini_write(outstream_t *out, ini_t *ini, iniopt_t *opt);
+bool ini_write_file(arena_t scratch, strview_t filename, ini_t *ini, iniopt_t *opt);
+
+// incremental editor: changes single keys and leaves everything else in the
+// text (comments, spacing, order) as it was. new keys go after the last value
+// of their table, new tables at the end of the file
+typedef struct inipatch_t inipatch_t;
+
+typedef struct iniedit_t iniedit_t;
+struct iniedit_t {
+    arena_t *arena;
+    ini_t ini;
+    iniopt_t options;
+    // sorted by where they go in ini.text
+    inipatch_t *patches;
+};
+
+iniedit_t ini_edit_init(arena_t *arena, strview_t text, iniopt_t *opt);
+// reads the file into the arena
+iniedit_t ini_edit_open(arena_t *arena, strview_t filename, iniopt_t *opt);
+// table can be INI_ROOT or empty, everything is copied into the arena. returns
+// false (and changes nothing) if the value has new lines or comment characters,
+// or the key/table name couldn't be parsed back
+bool ini_edit_set(iniedit_t *edit, strview_t table, strview_t key, strview_t value);
+// the text with every change applied
+str_t ini_edit_to_str(arena_t *arena, iniedit_t *edit);
+// the file must still contain the text the editor was made from, it fails if
+// the file doesn't exist or its size changed. when every change keeps its size
+// only those bytes are written, otherwise everything from the first change
+// onward. the editor then continues from the new text
+bool ini_edit_save(iniedit_t *edit, strview_t filename);
+
 // == JSON ===========================================
 
 typedef enum jsontype_e {
@@ -75,6 +168,7 @@ typedef enum jsonflags_e {
     JSON_DEFAULT            = 0,
     JSON_NO_TRAILING_COMMAS = 1 << 0,
     JSON_NO_COMMENTS        = 1 << 1,
+    JSON_VALIDATE_UTF8      = 1 << 2,
 } jsonflags_e;
 
 typedef struct json_t json_t;
@@ -96,6 +190,8 @@ struct json_t {
 
 json_t *json_parse(arena_t *arena, strview_t filename, jsonflags_e flags);
 json_t *json_parse_str(arena_t *arena, strview_t str, jsonflags_e flags);
+// same as ini_parse_map
+json_t *json_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map, jsonflags_e flags);
 
 json_t *json_get(json_t *node, strview_t key);
 
@@ -149,6 +245,8 @@ struct xml_t {
 
 xml_t xml_parse(arena_t *arena, strview_t filename);
 xml_t xml_parse_str(arena_t *arena, strview_t xmlstr);
+// same as ini_parse_map
+xml_t xml_parse_map(arena_t *arena, strview_t filename, os_file_map_t *out_map);
 
 xmltag_t *xml_get_tag(xmltag_t *parent, strview_t key, bool recursive);
 strview_t xml_get_attribute(xmltag_t *tag, strview_t key);
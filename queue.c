@@ -0,0 +1,230 @@
+#include "queue.h"
+#include "os.h"
+
+#include <string.h>
+
+// how many times the blocking functions try again before going to sleep
+#define QUEUE__SPIN_COUNT (100)
+// the slot sequence number is at the start of an mpmc cell, the item after it
+#define QUEUE__CELL_DATA  (8)
+
+typedef bool (queue__try_fn)(void *queue, void *item);
+
+u32 queue__round_capacity(u32 capacity) {
+    u32 size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    return size;
+}
+
+// called after every push and pop. if nobody is waiting it is only a fence
+// and a load, which is what keeps the try_ functions cheap
+void queue__notify(queue__waitlist_t *list) {
+    // pairs with the seq_cst add in queue__wait_for: either we see the
+    // waiter, or the waiter sees what we just did to the queue
+    atomic_fence(ATOMIC_SEQ_CST);
+    if (atomic_load_u32(&list->waiters, ATOMIC_RELAXED)) {
+        atomic_add_u32(&list->seq, 1, ATOMIC_RELEASE);
+        os_futex_wake_one(&list->seq);
+    }
+}
+
+void queue__wait_for(queue__waitlist_t *list, queue__try_fn *try_fn, void *queue, void *item) {
+    for (int i = 0; i < QUEUE__SPIN_COUNT; ++i) {
+        if (try_fn(queue, item)) {
+            return;
+        }
+        cpu_relax();
+    }
+
+    while (true) {
+        u32 seq = atomic_load_u32(&list->seq, ATOMIC_ACQUIRE);
+        atomic_add_u32(&list->waiters, 1, ATOMIC_SEQ_CST);
+
+        bool done = try_fn(queue, item);
+        if (!done) {
+            os_futex_wait(&list->seq, seq, OS_WAIT_INFINITE);
+        }
+
+        atomic_add_u32(&list->waiters, (u32)-1, ATOMIC_RELAXED);
+        if (done) {
+            return;
+        }
+    }
+}
+
+// == SPSC ======================================
+
+spsc_t *spsc_init(arena_t *arena, u32 item_size, u32 capacity) {
+    u32 size = queue__round_capacity(capacity);
+
+    spsc_t *queue = alloc(arena, spsc_t, .align = 64);
+    queue->items = alloc(arena, u8, (usize)size * item_size, ALLOC_NOZERO, .align = 64);
+    queue->mask = size - 1;
+    queue->item_size = item_size;
+    return queue;
+}
+
+bool spsc_try_push(spsc_t *queue, const void *item) {
+    u32 head = atomic_load_u32(&queue->head, ATOMIC_RELAXED);
+
+    // only look at the consumer's index when the old copy says it's full
+    if ((head - queue->cached_tail) > queue->mask) {
+        queue->cached_tail = atomic_load_u32(&queue->tail, ATOMIC_ACQUIRE);
+        if ((head - queue->cached_tail) > queue->mask) {
+            return false;
+        }
+    }
+
+    memcpy(queue->items + (usize)(head & queue->mask) * queue->item_size, item, queue->item_size);
+    atomic_store_u32(&queue->head, head + 1, ATOMIC_RELEASE);
+
+    queue__notify(&queue->not_empty);
+    return true;
+}
+
+bool spsc_try_pop(spsc_t *queue, void *out) {
+    u32 tail = atomic_load_u32(&queue->tail, ATOMIC_RELAXED);
+
+    if (tail == queue->cached_head) {
+        queue->cached_head = atomic_load_u32(&queue->head, ATOMIC_ACQUIRE);
+        if (tail == queue->cached_head) {
+            return false;
+        }
+    }
+
+    memcpy(out, queue->items + (usize)(tail & queue->mask) * queue->item_size, queue->item_size);
+    atomic_store_u32(&queue->tail, tail + 1, ATOMIC_RELEASE);
+
+    queue__notify(&queue->not_full);
+    return true;
+}
+
+bool spsc__try_push(void *queue, void *item) {
+    return spsc_try_push(queue, item);
+}
+
+bool spsc__try_pop(void *queue, void *item) {
+    return spsc_try_pop(queue, item);
+}
+
+void spsc_push(spsc_t *queue, const void *item) {
+    queue__wait_for(&queue->not_full, spsc__try_push, queue, (void *)item);
+}
+
+void spsc_pop(spsc_t *queue, void *out) {
+    queue__wait_for(&queue->not_empty, spsc__try_pop, queue, out);
+}
+
+u32 spsc_count(spsc_t *queue) {
+    u32 tail = atomic_load_u32(&queue->tail, ATOMIC_ACQUIRE);
+    u32 head = atomic_load_u32(&queue->head, ATOMIC_ACQUIRE);
+    return head - tail;
+}
+
+// == MPMC ======================================
+
+mpmc_t *mpmc_init(arena_t *arena, u32 item_size, u32 capacity) {
+    u32 size = queue__round_capacity(capacity);
+    u32 cell_size = (QUEUE__CELL_DATA + item_size + 7) & ~7u;
+
+    mpmc_t *queue = alloc(arena, mpmc_t, .align = 64);
+    u8 *cells = alloc(arena, u8, (usize)size * cell_size, ALLOC_NOZERO, .align = 64);
+
+    // a cell is free for position pos when seq == pos
+    for (u32 i = 0; i < size; ++i) {
+        *(u32 *)(cells + (usize)i * cell_size) = i;
+    }
+
+    queue->cells = cells;
+    queue->mask = size - 1;
+    queue->item_size = item_size;
+    queue->cell_size = cell_size;
+    return queue;
+}
+
+bool mpmc_try_push(mpmc_t *queue, const void *item) {
+    u8 *cell = NULL;
+    u32 pos = atomic_load_u32(&queue->head, ATOMIC_RELAXED);
+
+    while (true) {
+        cell = queue->cells + (usize)(pos & queue->mask) * queue->cell_size;
+        u32 seq = atomic_load_u32((volatile u32 *)cell, ATOMIC_ACQUIRE);
+        i32 diff = (i32)(seq - pos);
+
+        if (diff == 0) {
+            // on failure pos is updated to the current head
+            if (atomic_cas_u32(&queue->head, &pos, pos + 1, ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // the consumers haven't freed this slot from the last lap yet
+            return false;
+        }
+        else {
+            pos = atomic_load_u32(&queue->head, ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(cell + QUEUE__CELL_DATA, item, queue->item_size);
+    atomic_store_u32((volatile u32 *)cell, pos + 1, ATOMIC_RELEASE);
+
+    queue__notify(&queue->not_empty);
+    return true;
+}
+
+bool mpmc_try_pop(mpmc_t *queue, void *out) {
+    u8 *cell = NULL;
+    u32 pos = atomic_load_u32(&queue->tail, ATOMIC_RELAXED);
+
+    while (true) {
+        cell = queue->cells + (usize)(pos & queue->mask) * queue->cell_size;
+        u32 seq = atomic_load_u32((volatile u32 *)cell, ATOMIC_ACQUIRE);
+        i32 diff = (i32)(seq - (pos + 1));
+
+        if (diff == 0) {
+            if (atomic_cas_u32(&queue->tail, &pos, pos + 1, ATOMIC_RELAXED)) {
+                break;
+            }
+        }
+        else if (diff < 0) {
+            // nothing has been written here yet
+            return false;
+        }
+        else {
+            pos = atomic_load_u32(&queue->tail, ATOMIC_RELAXED);
+        }
+    }
+
+    memcpy(out, cell + QUEUE__CELL_DATA, queue->item_size);
+    // free it for the producers on the next lap
+    atomic_store_u32((volatile u32 *)cell, pos + queue->mask + 1, ATOMIC_RELEASE);
+
+    queue__notify(&queue->not_full);
+    return true;
+}
+
+bool mpmc__try_push(void *queue, void *item) {
+    return mpmc_try_push(queue, item);
+}
+
+bool mpmc__try_pop(void *queue, void *item) {
+    return mpmc_try_pop(queue, item);
+}
+
+void mpmc_push(mpmc_t *queue, const void *item) {
+    queue__wait_for(&queue->not_full, mpmc__try_push, queue, (void *)item);
+}
+
+void mpmc_pop(mpmc_t *queue, void *out) {
+    queue__wait_for(&queue->not_empty, mpmc__try_pop, queue, out);
+}
+
+u32 mpmc_count(mpmc_t *queue) {
+    u32 tail = atomic_load_u32(&queue->tail, ATOMIC_ACQUIRE);
+    u32 head = atomic_load_u32(&queue->head, ATOMIC_ACQUIRE);
+    i32 count = (i32)(head - tail);
+    return count < 0 ? 0 : MIN((u32)count, queue->mask + 1);
+}
@@ -0,0 +1,88 @@
+#ifndef COLLA_QUEUE_H
+#define COLLA_QUEUE_H
+
+#include "core.h"
+#include "arena.h"
+
+// bounded ring buffer queues that copy items in and out by value. the capacity
+// is rounded up to a power of 2 and never changes.
+//
+// the try_ functions never block and return false if the queue is full/empty,
+// the others sleep on a futex until there is space/an item. both can be mixed
+// freely on the same queue
+
+// waiters parked on one side of a queue
+typedef struct queue__waitlist_t queue__waitlist_t;
+struct queue__waitlist_t {
+    volatile u32 seq;
+    volatile u32 waiters;
+};
+
+// == SPSC ======================================
+
+// single producer, single consumer: push and pop are wait-free
+typedef struct spsc_t spsc_t;
+struct spsc_t {
+    u8 *items;
+    u32 mask;
+    u32 item_size;
+    u8 pad0[64];
+    // producer side
+    volatile u32 head;
+    u32 cached_tail;
+    u8 pad1[64];
+    // consumer side
+    volatile u32 tail;
+    u32 cached_head;
+    u8 pad2[64];
+    queue__waitlist_t not_empty;
+    u8 pad3[64];
+    queue__waitlist_t not_full;
+};
+
+// arena_t *arena, T type, u32 capacity
+#define spsc_make(arenaptr, type, capacity) spsc_init(arenaptr, sizeof(type), capacity)
+
+spsc_t *spsc_init(arena_t *arena, u32 item_size, u32 capacity);
+
+bool spsc_try_push(spsc_t *queue, const void *item);
+bool spsc_try_pop(spsc_t *queue, void *out);
+void spsc_push(spsc_t *queue, const void *item);
+void spsc_pop(spsc_t *queue, void *out);
+// only a snapshot, it might already be wrong when it returns
+u32 spsc_count(spsc_t *queue);
+
+// == MPMC ======================================
+
+// multiple producers, multiple consumers. every slot has a sequence number
+// that says if it is free or ready, so producers and consumers only fight
+// over their own index
+typedef struct mpmc_t mpmc_t;
+struct mpmc_t {
+    u8 *cells;
+    u32 mask;
+    u32 item_size;
+    u32 cell_size;
+    u8 pad0[64];
+    volatile u32 head;
+    u8 pad1[64];
+    volatile u32 tail;
+    u8 pad2[64];
+    queue__waitlist_t not_empty;
+    u8 pad3[64];
+    queue__waitlist_t not_full;
+};
+
+// arena_t *arena, T type, u32 capacity
+#define mpmc_make(arenaptr, type, capacity) mpmc_init(arenaptr, sizeof(type), capacity)
+
+mpmc_t *mpmc_init(arena_t *arena, u32 item_size, u32 capacity);
+
+bool mpmc_try_push(mpmc_t *queue, const void *item);
+bool mpmc_try_pop(mpmc_t *queue, void *out);
+void mpmc_push(mpmc_t *queue, const void *item);
+void mpmc_pop(mpmc_t *queue, void *out);
+// only a snapshot, it might already be wrong when it returns
+u32 mpmc_count(mpmc_t *queue);
+
+#endif
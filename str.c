@@ -1,13 +1,104 @@
 #include "str.h"
 
+#include <assert.h>
 #include <limits.h>
 #include <math.h>
 #include <stdlib.h>
 
-#if COLLA_WIN
-#include "win/str_win32.c"
+#if COLLA_SSSE3 || COLLA_SSSE3_RUNTIME
+#include <tmmintrin.h>
+#elif COLLA_SSE2
+#include <emmintrin.h>
+#endif
+
+#if COLLA_NEON
+#include <arm_neon.h>
+#endif
+
+#if COLLA_MSVC && COLLA_SSE2
+#include <intrin.h>
+#endif
+
+static usize str__utf8_to_utf16_len(const u8 *src, usize len);
+static usize str__utf8_to_utf16(u16 *dst, const u8 *src, usize len);
+static usize str__utf16_to_utf8_len(const u16 *src, usize len);
+static usize str__utf16_to_utf8(char *dst, const u16 *src, usize len);
+
+// branch-free ascii case folding, everything outside of [A-Z] or [a-z] is left untouched
+#define STR__LOWER(c) ((char)((c) | (((u8)((c) - 'A') < 26) << 5)))
+#define STR__UPPER(c) ((char)((c) ^ (((u8)((c) - 'a') < 26) << 5)))
+
+#if COLLA_SSE2
+
+// sets the 0x20 bit of every byte in [from, from + 26)
+static inline __m128i str__sse_case_bit(__m128i v, char from) {
+    // unsigned (v - from) < 26 becomes a signed compare once the sign bit is flipped
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8((char)(from + 128)));
+    __m128i in_range = _mm_cmplt_epi8(shifted, _mm_set1_epi8(-128 + 26));
+    return _mm_and_si128(in_range, _mm_set1_epi8(0x20));
+}
+
+static inline __m128i str__sse_lower(__m128i v) {
+    return _mm_or_si128(v, str__sse_case_bit(v, 'A'));
+}
+
+static inline __m128i str__sse_upper(__m128i v) {
+    return _mm_xor_si128(v, str__sse_case_bit(v, 'a'));
+}
+
+// only works if v != 0
+static inline u32 str__ctz(u32 v) {
+#if COLLA_MSVC
+    unsigned long index = 0;
+    _BitScanForward(&index, v);
+    return (u32)index;
 #else
-#error "platform not supported"
+    return (u32)__builtin_ctz(v);
+#endif
+}
+
+static inline u32 str__popcount(u32 v) {
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+}
+
+#define STR__MAX_SIMD_DELIMS 16
+
+// bitmask of the bytes in v that match any of the needles
+static inline u32 str__sse_either_mask(__m128i v, const __m128i *needles, usize count) {
+    __m128i eq = _mm_cmpeq_epi8(v, needles[0]);
+    for (usize k = 1; k < count; ++k) {
+        eq = _mm_or_si128(eq, _mm_cmpeq_epi8(v, needles[k]));
+    }
+    return (u32)_mm_movemask_epi8(eq);
+}
+
+#elif COLLA_NEON
+
+#define STR__MAX_SIMD_DELIMS 16
+
+static inline bool str__neon_has_either(uint8x16_t v, const uint8x16_t *needles, usize count) {
+    uint8x16_t eq = vceqq_u8(v, needles[0]);
+    for (usize k = 1; k < count; ++k) {
+        eq = vorrq_u8(eq, vceqq_u8(v, needles[k]));
+    }
+    return vmaxvq_u8(eq) != 0;
+}
+
+static inline uint8x16_t str__neon_case_bit(uint8x16_t v, char from) {
+    uint8x16_t in_range = vcltq_u8(vsubq_u8(v, vdupq_n_u8((u8)from)), vdupq_n_u8(26));
+    return vandq_u8(in_range, vdupq_n_u8(0x20));
+}
+
+static inline uint8x16_t str__neon_lower(uint8x16_t v) {
+    return vorrq_u8(v, str__neon_case_bit(v, 'A'));
+}
+
+static inline uint8x16_t str__neon_upper(uint8x16_t v) {
+    return veorq_u8(v, str__neon_case_bit(v, 'a'));
+}
+
 #endif
 
 // == STR_T ========================================================
@@ -64,7 +155,10 @@ tstr_t tstr_init(TCHAR *str, usize optional_len) {
 
 str16_t str16_init(u16 *str, usize optional_len) {
     if (str && !optional_len) {
-        optional_len = wcslen(str);
+        // wchar_t is not 16 bits everywhere, so we can't use wcslen
+        while (str[optional_len]) {
+            optional_len++;
+        }
     }
     return (str16_t){
         .buf = str,
@@ -76,7 +170,12 @@ str_t str_from_str16(arena_t *arena, str16_t src) {
     if (!src.buf) return STR_EMPTY;
     if (!src.len) return STR_EMPTY;
 
-    str_t out = str_os_from_str16(arena, src);
+    str_t out = STR_EMPTY;
+
+    out.len = str__utf16_to_utf8_len(src.buf, src.len);
+    out.buf = alloc(arena, char, out.len + 1, ALLOC_NOZERO);
+    str__utf16_to_utf8(out.buf, src.buf, src.len);
+    out.buf[out.len] = '\0';
 
     return out;
 }
@@ -122,25 +221,65 @@ bool str_is_empty(str_t ctx) {
 }
 
 void str_lower(str_t *src) {
-    for (usize i = 0; i < src->len; ++i) {
-        if (src->buf[i] >= 'A' && src->buf[i] <= 'Z') {
-            src->buf[i] += 'a' - 'A';
-        }
+    if (!src) return;
+    char *buf = src->buf;
+    usize i = 0;
+#if COLLA_SSE2
+    for (; i + 16 <= src->len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        _mm_storeu_si128((__m128i *)(buf + i), str__sse_lower(v));
+    }
+#elif COLLA_NEON
+    for (; i + 16 <= src->len; i += 16) {
+        vst1q_u8((u8 *)buf + i, str__neon_lower(vld1q_u8((const u8 *)buf + i)));
+    }
+#endif
+    for (; i < src->len; ++i) {
+        buf[i] = STR__LOWER(buf[i]);
     }
 }
 
 void str_upper(str_t *src) {
-    for (usize i = 0; i < src->len; ++i) {
-        if (src->buf[i] >= 'a' && src->buf[i] <= 'z') {
-            src->buf[i] -= 'a' - 'A';
-        }
+    if (!src) return;
+    char *buf = src->buf;
+    usize i = 0;
+#if COLLA_SSE2
+    for (; i + 16 <= src->len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        _mm_storeu_si128((__m128i *)(buf + i), str__sse_upper(v));
+    }
+#elif COLLA_NEON
+    for (; i + 16 <= src->len; i += 16) {
+        vst1q_u8((u8 *)buf + i, str__neon_upper(vld1q_u8((const u8 *)buf + i)));
+    }
+#endif
+    for (; i < src->len; ++i) {
+        buf[i] = STR__UPPER(buf[i]);
     }
 }
 
 void str_replace(str_t *ctx, char from, char to) {
     if (!ctx) return;
     char *buf = ctx->buf;
-    for (usize i = 0; i < ctx->len; ++i) {
+    usize i = 0;
+#if COLLA_SSE2
+    __m128i vfrom = _mm_set1_epi8(from);
+    __m128i vto = _mm_set1_epi8(to);
+    for (; i + 16 <= ctx->len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        __m128i eq = _mm_cmpeq_epi8(v, vfrom);
+        v = _mm_or_si128(_mm_and_si128(eq, vto), _mm_andnot_si128(eq, v));
+        _mm_storeu_si128((__m128i *)(buf + i), v);
+    }
+#elif COLLA_NEON
+    uint8x16_t vfrom = vdupq_n_u8((u8)from);
+    uint8x16_t vto = vdupq_n_u8((u8)to);
+    for (; i + 16 <= ctx->len; i += 16) {
+        uint8x16_t v = vld1q_u8((const u8 *)buf + i);
+        vst1q_u8((u8 *)buf + i, vbslq_u8(vceqq_u8(v, vfrom), vto, v));
+    }
+#endif
+    for (; i < ctx->len; ++i) {
         buf[i] = buf[i] == from ? to : buf[i];
     }
 }
@@ -186,6 +325,159 @@ int strv_compare(strview_t a, strview_t b) {
         (int)(a.len - b.len);
 }
 
+// returns the index of the first byte that differs once both are lowercased, or len if they match
+static usize str__mismatch_nocase(const char *a, const char *b, usize len) {
+    usize i = 0;
+#if COLLA_SSE2
+    for (; i + 16 <= len; i += 16) {
+        __m128i va = str__sse_lower(_mm_loadu_si128((const __m128i *)(a + i)));
+        __m128i vb = str__sse_lower(_mm_loadu_si128((const __m128i *)(b + i)));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+        if (mask != 0xFFFF) {
+            break;
+        }
+    }
+#elif COLLA_NEON
+    for (; i + 16 <= len; i += 16) {
+        uint8x16_t va = str__neon_lower(vld1q_u8((const u8 *)a + i));
+        uint8x16_t vb = str__neon_lower(vld1q_u8((const u8 *)b + i));
+        if (vminvq_u8(vceqq_u8(va, vb)) != 0xFF) {
+            break;
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (STR__LOWER(a[i]) != STR__LOWER(b[i])) {
+            break;
+        }
+    }
+    return i;
+}
+
+bool strv_equals_nocase(strview_t a, strview_t b) {
+    return a.len == b.len && str__mismatch_nocase(a.buf, b.buf, a.len) == a.len;
+}
+
+int strv_compare_nocase(strview_t a, strview_t b) {
+    // same ordering as strv_compare: shorter strings come first
+    if (a.len != b.len) {
+        return a.len < b.len ? -1 : 1;
+    }
+    usize pos = str__mismatch_nocase(a.buf, b.buf, a.len);
+    if (pos == a.len) {
+        return 0;
+    }
+    return (int)(u8)STR__LOWER(a.buf[pos]) - (int)(u8)STR__LOWER(b.buf[pos]);
+}
+
+#define STR__FNV_OFFSET 0xcbf29ce484222325ull
+#define STR__FNV_PRIME  0x100000001b3ull
+
+u64 strv_hash(strview_t ctx) {
+    u64 hash = STR__FNV_OFFSET;
+    for (usize i = 0; i < ctx.len; ++i) {
+        hash = (hash ^ (u8)ctx.buf[i]) * STR__FNV_PRIME;
+    }
+    return hash;
+}
+
+u64 strv_hash_nocase(strview_t ctx) {
+    u64 hash = STR__FNV_OFFSET;
+    for (usize i = 0; i < ctx.len; ++i) {
+        hash = (hash ^ (u8)STR__LOWER(ctx.buf[i])) * STR__FNV_PRIME;
+    }
+    return hash;
+}
+
+// returns the index of the first byte in buf that is one of chars, or len if there are none
+static usize str__find_either(const char *buf, usize len, strview_t chars) {
+    usize i = 0;
+    if (chars.len == 0) {
+        return len;
+    }
+    if (chars.len == 1) {
+        const char *found = memchr(buf, chars.buf[0], len);
+        return found ? (usize)(found - buf) : len;
+    }
+#if COLLA_SSE2
+    if (chars.len <= STR__MAX_SIMD_DELIMS) {
+        __m128i needles[STR__MAX_SIMD_DELIMS];
+        for (usize k = 0; k < chars.len; ++k) {
+            needles[k] = _mm_set1_epi8(chars.buf[k]);
+        }
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+            u32 mask = str__sse_either_mask(v, needles, chars.len);
+            if (mask) {
+                return i + str__ctz(mask);
+            }
+        }
+    }
+#elif COLLA_NEON
+    if (chars.len <= STR__MAX_SIMD_DELIMS) {
+        uint8x16_t needles[STR__MAX_SIMD_DELIMS];
+        for (usize k = 0; k < chars.len; ++k) {
+            needles[k] = vdupq_n_u8((u8)chars.buf[k]);
+        }
+        for (; i + 16 <= len; i += 16) {
+            // find the exact position with the scalar loop below
+            if (str__neon_has_either(vld1q_u8((const u8 *)buf + i), needles, chars.len)) {
+                break;
+            }
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (memchr(chars.buf, buf[i], chars.len)) {
+            return i;
+        }
+    }
+    return len;
+}
+
+// counts how many bytes in buf are one of chars
+static usize str__count_either(const char *buf, usize len, strview_t chars) {
+    usize count = 0;
+    usize i = 0;
+    if (chars.len == 0) {
+        return 0;
+    }
+#if COLLA_SSE2
+    if (chars.len <= STR__MAX_SIMD_DELIMS) {
+        __m128i needles[STR__MAX_SIMD_DELIMS];
+        for (usize k = 0; k < chars.len; ++k) {
+            needles[k] = _mm_set1_epi8(chars.buf[k]);
+        }
+        for (; i + 16 <= len; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+            count += str__popcount(str__sse_either_mask(v, needles, chars.len));
+        }
+    }
+#elif COLLA_NEON
+    if (chars.len <= STR__MAX_SIMD_DELIMS) {
+        uint8x16_t needles[STR__MAX_SIMD_DELIMS];
+        for (usize k = 0; k < chars.len; ++k) {
+            needles[k] = vdupq_n_u8((u8)chars.buf[k]);
+        }
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t v = vld1q_u8((const u8 *)buf + i);
+            uint8x16_t eq = vceqq_u8(v, needles[0]);
+            for (usize k = 1; k < chars.len; ++k) {
+                eq = vorrq_u8(eq, vceqq_u8(v, needles[k]));
+            }
+            // each match is 0xFF, so shifting by 7 leaves 1 per match
+            count += vaddvq_u8(vshrq_n_u8(eq, 7));
+        }
+    }
+#endif
+    for (; i < len; ++i) {
+        if (memchr(chars.buf, buf[i], chars.len)) {
+            ++count;
+        }
+    }
+    return count;
+}
+
 char strv_front(strview_t ctx) {
     return ctx.len > 0 ? ctx.buf[0] : '\0';
 }
@@ -195,7 +487,20 @@ char strv_back(strview_t ctx) {
 }
 
 str16_t strv_to_str16(arena_t *arena, strview_t src) {
-    return strv_os_to_str16(arena, src);
+    str16_t out = {0};
+
+    if (strv_is_empty(src)) {
+        return out;
+    }
+
+    const u8 *bytes = (const u8 *)src.buf;
+
+    out.len = str__utf8_to_utf16_len(bytes, src.len);
+    out.buf = alloc(arena, u16, out.len + 1, ALLOC_NOZERO);
+    str__utf8_to_utf16(out.buf, bytes, src.len);
+    out.buf[out.len] = 0;
+
+    return out;
 }
 
 tstr_t strv_to_tstr(arena_t *arena, strview_t src) {
@@ -275,12 +580,7 @@ bool strv_ends_with_view(strview_t ctx, strview_t view) {
 }
 
 bool strv_contains(strview_t ctx, char c) {
-    for(usize i = 0; i < ctx.len; ++i) {
-        if(ctx.buf[i] == c) {
-            return true;
-        }
-    }
-    return false;
+    return ctx.len > 0 && memchr(ctx.buf, c, ctx.len) != NULL;
 }
 
 bool strv_contains_view(strview_t ctx, strview_t view) {
@@ -295,22 +595,13 @@ bool strv_contains_view(strview_t ctx, strview_t view) {
 }
 
 bool strv_contains_either(strview_t ctx, strview_t chars) {
-    for (usize i = 0; i < ctx.len; ++i) {
-        if (strv_contains(chars, ctx.buf[i])) {
-            return true;
-        }
-    }
-
-    return false;
+    return str__find_either(ctx.buf, ctx.len, chars) < ctx.len;
 }
 
 usize strv_find(strview_t ctx, char c, usize from) {
-    for (usize i = from; i < ctx.len; ++i) {
-        if (ctx.buf[i] == c) {
-            return i;
-        }
-    }
-    return STR_NONE;
+    if (from >= ctx.len) return STR_NONE;
+    const char *found = memchr(ctx.buf + from, c, ctx.len - from);
+    return found ? (usize)(found - ctx.buf) : STR_NONE;
 }
 
 usize strv_find_view(strview_t ctx, strview_t view, usize from) {
@@ -324,15 +615,9 @@ usize strv_find_view(strview_t ctx, strview_t view, usize from) {
 }
 
 usize strv_find_either(strview_t ctx, strview_t chars, usize from) {
-    if (from > ctx.len) from = ctx.len;
-    
-    for (usize i = from; i < ctx.len; ++i) {
-        if (strv_contains(chars, ctx.buf[i])) {
-            return i;
-        }
-    }
-
-    return STR_NONE;
+    if (from >= ctx.len) return STR_NONE;
+    usize pos = from + str__find_either(ctx.buf + from, ctx.len - from, chars);
+    return pos < ctx.len ? pos : STR_NONE;
 }
 
 usize strv_rfind(strview_t ctx, char c, usize from_right) {
@@ -360,6 +645,532 @@ usize strv_rfind_view(strview_t ctx, strview_t view, usize from_right) {
     return STR_NONE;
 }
 
+strv_split_t strv_split(strview_t ctx, strview_t delims) {
+    return (strv_split_t){
+        .src = ctx,
+        .delims = delims,
+    };
+}
+
+bool strv_split_next(strv_split_t *it) {
+    if (!it || it->pos >= it->src.len) {
+        return false;
+    }
+
+    const char *beg = it->src.buf + it->pos;
+    usize rem = it->src.len - it->pos;
+    usize len = str__find_either(beg, rem, it->delims);
+
+    it->value = (strview_t){ beg, len };
+    // skip the delimiter too
+    it->pos += len + 1;
+
+    return true;
+}
+
+strv_array_t strv_split_all(arena_t *arena, strview_t ctx, strview_t delims) {
+    if (strv_is_empty(ctx)) {
+        return (strv_array_t){0};
+    }
+
+    // count first, so that all the views end up in a single allocation
+    usize count = str__count_either(ctx.buf, ctx.len, delims) + 1;
+    // a delimiter at the very end doesn't start a new field
+    if (delims.len && memchr(delims.buf, ctx.buf[ctx.len - 1], delims.len)) {
+        --count;
+    }
+
+    strview_t *items = alloc(arena, strview_t, count, ALLOC_NOZERO);
+    usize index = 0;
+
+    for (strv_split_t it = strv_split(ctx, delims); strv_split_next(&it);) {
+        items[index++] = it.value;
+    }
+
+    assert(index == count);
+
+    return (strv_array_t){
+        .items = items,
+        .count = count,
+    };
+}
+
+// == UTF-8 ========================================================
+
+#define STR__UTF8_TOO_SHORT      (1 << 0)
+#define STR__UTF8_TOO_LONG       (1 << 1)
+#define STR__UTF8_OVERLONG_3     (1 << 2)
+#define STR__UTF8_TOO_LARGE      (1 << 3)
+#define STR__UTF8_SURROGATE      (1 << 4)
+#define STR__UTF8_OVERLONG_2     (1 << 5)
+#define STR__UTF8_TOO_LARGE_1000 (1 << 6)
+#define STR__UTF8_OVERLONG_4     (1 << 6)
+#define STR__UTF8_TWO_CONTS      (1 << 7)
+#define STR__UTF8_CARRY          (STR__UTF8_TOO_SHORT | STR__UTF8_TOO_LONG | STR__UTF8_TWO_CONTS)
+
+// lookup tables for the Keiser-Lemire validation algorithm, each byte pair
+// is classified by the high nibble of the first byte, the low nibble of the
+// first byte and the high nibble of the second byte. the three lookups are
+// and-ed together, any bit left on is an error
+
+// indexed by the high nibble of the previous byte
+static const u8 str__utf8_byte_1_high[16] = {
+    // 0_______ ________ <ascii in byte 1>
+    STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG,
+    STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG, STR__UTF8_TOO_LONG,
+    // 10______ ________ <continuation in byte 1>
+    STR__UTF8_TWO_CONTS, STR__UTF8_TWO_CONTS, STR__UTF8_TWO_CONTS, STR__UTF8_TWO_CONTS,
+    // 1100____ ________ <two byte lead in byte 1>
+    STR__UTF8_TOO_SHORT | STR__UTF8_OVERLONG_2,
+    // 1101____ ________ <two byte lead in byte 1>
+    STR__UTF8_TOO_SHORT,
+    // 1110____ ________ <three byte lead in byte 1>
+    STR__UTF8_TOO_SHORT | STR__UTF8_OVERLONG_3 | STR__UTF8_SURROGATE,
+    // 1111____ ________ <four+ byte lead in byte 1>
+    STR__UTF8_TOO_SHORT | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000 | STR__UTF8_OVERLONG_4,
+};
+
+// indexed by the low nibble of the previous byte
+static const u8 str__utf8_byte_1_low[16] = {
+    // ____0000 ________
+    STR__UTF8_CARRY | STR__UTF8_OVERLONG_3 | STR__UTF8_OVERLONG_2 | STR__UTF8_OVERLONG_4,
+    // ____0001 ________
+    STR__UTF8_CARRY | STR__UTF8_OVERLONG_2,
+    // ____001_ ________
+    STR__UTF8_CARRY,
+    STR__UTF8_CARRY,
+    // ____0100 ________
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE,
+    // ____0101 ________
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    // ____011_ ________
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    // ____1___ ________
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    // ____1101 ________
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000 | STR__UTF8_SURROGATE,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+    STR__UTF8_CARRY | STR__UTF8_TOO_LARGE | STR__UTF8_TOO_LARGE_1000,
+};
+
+// indexed by the high nibble of the current byte
+static const u8 str__utf8_byte_2_high[16] = {
+    // ________ 0_______ <ascii in byte 2>
+    STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT,
+    STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT,
+    // ________ 1000____
+    STR__UTF8_TOO_LONG | STR__UTF8_OVERLONG_2 | STR__UTF8_TWO_CONTS | STR__UTF8_OVERLONG_3 | STR__UTF8_TOO_LARGE_1000 | STR__UTF8_OVERLONG_4,
+    // ________ 1001____
+    STR__UTF8_TOO_LONG | STR__UTF8_OVERLONG_2 | STR__UTF8_TWO_CONTS | STR__UTF8_OVERLONG_3 | STR__UTF8_TOO_LARGE,
+    // ________ 101_____
+    STR__UTF8_TOO_LONG | STR__UTF8_OVERLONG_2 | STR__UTF8_TWO_CONTS | STR__UTF8_SURROGATE | STR__UTF8_TOO_LARGE,
+    STR__UTF8_TOO_LONG | STR__UTF8_OVERLONG_2 | STR__UTF8_TWO_CONTS | STR__UTF8_SURROGATE | STR__UTF8_TOO_LARGE,
+    // ________ 11______
+    STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT, STR__UTF8_TOO_SHORT,
+};
+
+// the last three bytes of a block can't be the start of a sequence
+// that would continue past the end of the input
+static const u8 str__utf8_max_incomplete[16] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1,
+};
+
+#if COLLA_SSSE3 || COLLA_SSSE3_RUNTIME
+
+static bool str__utf8_validate_simd(const u8 *buf, usize len) {
+    const __m128i tbl_1_high = _mm_loadu_si128((const __m128i *)str__utf8_byte_1_high);
+    const __m128i tbl_1_low  = _mm_loadu_si128((const __m128i *)str__utf8_byte_1_low);
+    const __m128i tbl_2_high = _mm_loadu_si128((const __m128i *)str__utf8_byte_2_high);
+    const __m128i max_incomplete = _mm_loadu_si128((const __m128i *)str__utf8_max_incomplete);
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    const __m128i third_byte  = _mm_set1_epi8((char)(0xE0 - 0x80));
+    const __m128i fourth_byte = _mm_set1_epi8((char)(0xF0 - 0x80));
+    const __m128i high_bit = _mm_set1_epi8((char)0x80);
+
+    __m128i error = _mm_setzero_si128();
+    __m128i prev = _mm_setzero_si128();
+    __m128i prev_incomplete = _mm_setzero_si128();
+
+    u8 tail[16];
+
+    for (usize i = 0; i < len; i += 16) {
+        __m128i input;
+        if (i + 16 <= len) {
+            input = _mm_loadu_si128((const __m128i *)(buf + i));
+        }
+        else {
+            // pad the last block with zeroes, which are valid ascii
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, buf + i, len - i);
+            input = _mm_loadu_si128((const __m128i *)tail);
+        }
+
+        // ascii blocks are always valid, as long as the previous block finished its sequence
+        if (_mm_movemask_epi8(input) == 0) {
+            error = _mm_or_si128(error, prev_incomplete);
+        }
+        else {
+            __m128i prev1 = _mm_alignr_epi8(input, prev, 15);
+            __m128i byte_1_high = _mm_shuffle_epi8(tbl_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+            __m128i byte_1_low  = _mm_shuffle_epi8(tbl_1_low, _mm_and_si128(prev1, nibble));
+            __m128i byte_2_high = _mm_shuffle_epi8(tbl_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+            __m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+            __m128i prev2 = _mm_alignr_epi8(input, prev, 14);
+            __m128i prev3 = _mm_alignr_epi8(input, prev, 13);
+            __m128i is_third  = _mm_subs_epu8(prev2, third_byte);
+            __m128i is_fourth = _mm_subs_epu8(prev3, fourth_byte);
+            __m128i must_be_cont = _mm_and_si128(_mm_or_si128(is_third, is_fourth), high_bit);
+
+            error = _mm_or_si128(error, _mm_xor_si128(must_be_cont, special));
+            prev_incomplete = _mm_subs_epu8(input, max_incomplete);
+        }
+
+        prev = input;
+    }
+
+    error = _mm_or_si128(error, prev_incomplete);
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) == 0xFFFF;
+}
+
+#elif COLLA_NEON
+
+static bool str__utf8_validate_simd(const u8 *buf, usize len) {
+    const uint8x16_t tbl_1_high = vld1q_u8(str__utf8_byte_1_high);
+    const uint8x16_t tbl_1_low  = vld1q_u8(str__utf8_byte_1_low);
+    const uint8x16_t tbl_2_high = vld1q_u8(str__utf8_byte_2_high);
+    const uint8x16_t max_incomplete = vld1q_u8(str__utf8_max_incomplete);
+    const uint8x16_t nibble = vdupq_n_u8(0x0F);
+    const uint8x16_t third_byte  = vdupq_n_u8(0xE0 - 0x80);
+    const uint8x16_t fourth_byte = vdupq_n_u8(0xF0 - 0x80);
+    const uint8x16_t high_bit = vdupq_n_u8(0x80);
+
+    uint8x16_t error = vdupq_n_u8(0);
+    uint8x16_t prev = vdupq_n_u8(0);
+    uint8x16_t prev_incomplete = vdupq_n_u8(0);
+
+    u8 tail[16];
+
+    for (usize i = 0; i < len; i += 16) {
+        uint8x16_t input;
+        if (i + 16 <= len) {
+            input = vld1q_u8(buf + i);
+        }
+        else {
+            // pad the last block with zeroes, which are valid ascii
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, buf + i, len - i);
+            input = vld1q_u8(tail);
+        }
+
+        // ascii blocks are always valid, as long as the previous block finished its sequence
+        if (vmaxvq_u8(input) < 0x80) {
+            error = vorrq_u8(error, prev_incomplete);
+        }
+        else {
+            uint8x16_t prev1 = vextq_u8(prev, input, 15);
+            uint8x16_t byte_1_high = vqtbl1q_u8(tbl_1_high, vshrq_n_u8(prev1, 4));
+            uint8x16_t byte_1_low  = vqtbl1q_u8(tbl_1_low, vandq_u8(prev1, nibble));
+            uint8x16_t byte_2_high = vqtbl1q_u8(tbl_2_high, vshrq_n_u8(input, 4));
+            uint8x16_t special = vandq_u8(vandq_u8(byte_1_high, byte_1_low), byte_2_high);
+
+            uint8x16_t prev2 = vextq_u8(prev, input, 14);
+            uint8x16_t prev3 = vextq_u8(prev, input, 13);
+            uint8x16_t is_third  = vqsubq_u8(prev2, third_byte);
+            uint8x16_t is_fourth = vqsubq_u8(prev3, fourth_byte);
+            uint8x16_t must_be_cont = vandq_u8(vorrq_u8(is_third, is_fourth), high_bit);
+
+            error = vorrq_u8(error, veorq_u8(must_be_cont, special));
+            prev_incomplete = vqsubq_u8(input, max_incomplete);
+        }
+
+        prev = input;
+    }
+
+    error = vorrq_u8(error, prev_incomplete);
+    return vmaxvq_u8(error) == 0;
+}
+
+#endif
+
+#if COLLA_SSSE3_RUNTIME
+
+static bool str__has_ssse3(void) {
+    // every thread that races here writes the same value
+    static volatile int has_ssse3 = -1;
+    if (has_ssse3 < 0) {
+        int info[4];
+        __cpuid(info, 1);
+        has_ssse3 = (info[2] >> 9) & 1; // ecx bit 9
+    }
+    return has_ssse3 == 1;
+}
+
+#endif
+
+// returns how many leading bytes are ascii
+static usize str__ascii_prefix(const u8 *buf, usize len) {
+    usize i = 0;
+#if COLLA_SSE2
+    for (; i + 16 <= len; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(buf + i)));
+        if (mask) {
+            break;
+        }
+    }
+#elif COLLA_NEON
+    for (; i + 16 <= len; i += 16) {
+        if (vmaxvq_u8(vld1q_u8(buf + i)) >= 0x80) {
+            break;
+        }
+    }
+#endif
+    while (i < len && buf[i] < 0x80) {
+        ++i;
+    }
+    return i;
+}
+
+// decodes a single codepoint, returns the number of bytes used or 0 if the sequence is invalid
+static usize str__utf8_decode(const u8 *buf, usize len, u32 *codepoint) {
+    u8 c = buf[0];
+    usize count = 0;
+    u32 cp = 0;
+    u32 min = 0;
+
+    if (c < 0x80) {
+        *codepoint = c;
+        return 1;
+    }
+    else if ((c & 0xE0) == 0xC0) {
+        count = 2; cp = c & 0x1F; min = 0x80;
+    }
+    else if ((c & 0xF0) == 0xE0) {
+        count = 3; cp = c & 0x0F; min = 0x800;
+    }
+    else if ((c & 0xF8) == 0xF0) {
+        count = 4; cp = c & 0x07; min = 0x10000;
+    }
+    else {
+        return 0;
+    }
+
+    if (count > len) {
+        return 0;
+    }
+
+    for (usize i = 1; i < count; ++i) {
+        if ((buf[i] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = (cp << 6) | (buf[i] & 0x3F);
+    }
+
+    if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        return 0;
+    }
+
+    *codepoint = cp;
+    return count;
+}
+
+bool strv_is_utf8(strview_t ctx) {
+    if (strv_is_empty(ctx)) return true;
+
+    const u8 *buf = (const u8 *)ctx.buf;
+
+#if COLLA_SSSE3 || COLLA_NEON
+    return str__utf8_validate_simd(buf, ctx.len);
+#else
+#if COLLA_SSSE3_RUNTIME
+    if (str__has_ssse3()) {
+        return str__utf8_validate_simd(buf, ctx.len);
+    }
+#endif
+    usize i = 0;
+    while (i < ctx.len) {
+        i += str__ascii_prefix(buf + i, ctx.len - i);
+        if (i >= ctx.len) break;
+        u32 cp = 0;
+        usize count = str__utf8_decode(buf + i, ctx.len - i, &cp);
+        if (count == 0) {
+            return false;
+        }
+        i += count;
+    }
+    return true;
+#endif
+}
+
+// invalid sequences are replaced with U+FFFD, like MultiByteToWideChar does
+
+static usize str__utf8_to_utf16_len(const u8 *src, usize len) {
+    usize out = 0;
+    usize i = 0;
+    while (i < len) {
+        usize ascii = str__ascii_prefix(src + i, len - i);
+        out += ascii;
+        i += ascii;
+        if (i >= len) break;
+
+        u32 cp = 0;
+        usize count = str__utf8_decode(src + i, len - i, &cp);
+        i += count ? count : 1;
+        out += cp >= 0x10000 ? 2 : 1;
+    }
+    return out;
+}
+
+static usize str__utf8_to_utf16(u16 *dst, const u8 *src, usize len) {
+    u16 *beg = dst;
+    usize i = 0;
+    while (i < len) {
+#if COLLA_SSE2
+        // widen 16 ascii characters at a time
+        for (; i + 16 <= len; i += 16) {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            if (_mm_movemask_epi8(in)) {
+                break;
+            }
+            __m128i zero = _mm_setzero_si128();
+            _mm_storeu_si128((__m128i *)dst,       _mm_unpacklo_epi8(in, zero));
+            _mm_storeu_si128((__m128i *)(dst + 8), _mm_unpackhi_epi8(in, zero));
+            dst += 16;
+        }
+#elif COLLA_NEON
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t in = vld1q_u8(src + i);
+            if (vmaxvq_u8(in) >= 0x80) {
+                break;
+            }
+            vst1q_u16(dst,     vmovl_u8(vget_low_u8(in)));
+            vst1q_u16(dst + 8, vmovl_u8(vget_high_u8(in)));
+            dst += 16;
+        }
+#endif
+        while (i < len && src[i] < 0x80) {
+            *dst++ = src[i++];
+        }
+        if (i >= len) break;
+
+        u32 cp = 0;
+        usize count = str__utf8_decode(src + i, len - i, &cp);
+        if (!count) {
+            cp = 0xFFFD;
+            count = 1;
+        }
+        i += count;
+
+        if (cp >= 0x10000) {
+            cp -= 0x10000;
+            *dst++ = (u16)(0xD800 | (cp >> 10));
+            *dst++ = (u16)(0xDC00 | (cp & 0x3FF));
+        }
+        else {
+            *dst++ = (u16)cp;
+        }
+    }
+    return dst - beg;
+}
+
+// returns the number of utf16 units used, 0 if it is an unpaired surrogate
+static usize str__utf16_decode(const u16 *src, usize len, u32 *codepoint) {
+    u16 c = src[0];
+    if (c < 0xD800 || c > 0xDFFF) {
+        *codepoint = c;
+        return 1;
+    }
+    if (c <= 0xDBFF && len > 1 && src[1] >= 0xDC00 && src[1] <= 0xDFFF) {
+        *codepoint = 0x10000 + (((u32)c - 0xD800) << 10) + ((u32)src[1] - 0xDC00);
+        return 2;
+    }
+    return 0;
+}
+
+static usize str__utf16_to_utf8_len(const u16 *src, usize len) {
+    usize out = 0;
+    usize i = 0;
+    while (i < len) {
+        u32 cp = 0;
+        usize count = str__utf16_decode(src + i, len - i, &cp);
+        if (!count) {
+            cp = 0xFFFD;
+            count = 1;
+        }
+        i += count;
+
+        if      (cp < 0x80)    out += 1;
+        else if (cp < 0x800)   out += 2;
+        else if (cp < 0x10000) out += 3;
+        else                   out += 4;
+    }
+    return out;
+}
+
+static usize str__utf16_to_utf8(char *dst, const u16 *src, usize len) {
+    u8 *out = (u8 *)dst;
+    usize i = 0;
+    while (i < len) {
+#if COLLA_SSE2
+        // narrow 8 ascii units at a time
+        const __m128i not_ascii = _mm_set1_epi16((short)0xFF80);
+        for (; i + 8 <= len; i += 8) {
+            __m128i in = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i is_ascii = _mm_cmpeq_epi16(_mm_and_si128(in, not_ascii), _mm_setzero_si128());
+            if (_mm_movemask_epi8(is_ascii) != 0xFFFF) {
+                break;
+            }
+            _mm_storel_epi64((__m128i *)out, _mm_packus_epi16(in, in));
+            out += 8;
+        }
+#elif COLLA_NEON
+        for (; i + 8 <= len; i += 8) {
+            uint16x8_t in = vld1q_u16(src + i);
+            if (vmaxvq_u16(in) >= 0x80) {
+                break;
+            }
+            vst1_u8(out, vmovn_u16(in));
+            out += 8;
+        }
+#endif
+        while (i < len && src[i] < 0x80) {
+            *out++ = (u8)src[i++];
+        }
+        if (i >= len) break;
+
+        u32 cp = 0;
+        usize count = str__utf16_decode(src + i, len - i, &cp);
+        if (!count) {
+            cp = 0xFFFD;
+            count = 1;
+        }
+        i += count;
+
+        if (cp < 0x800) {
+            *out++ = (u8)(0xC0 | (cp >> 6));
+            *out++ = (u8)(0x80 | (cp & 0x3F));
+        }
+        else if (cp < 0x10000) {
+            *out++ = (u8)(0xE0 | (cp >> 12));
+            *out++ = (u8)(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = (u8)(0x80 | (cp & 0x3F));
+        }
+        else {
+            *out++ = (u8)(0xF0 | (cp >> 18));
+            *out++ = (u8)(0x80 | ((cp >> 12) & 0x3F));
+            *out++ = (u8)(0x80 | ((cp >> 6) & 0x3F));
+            *out++ = (u8)(0x80 | (cp & 0x3F));
+        }
+    }
+    return out - (u8 *)dst;
+}
+
 // == CTYPE ========================================================
 
 bool char_is_space(char c) {
@@ -374,6 +1185,14 @@ bool char_is_num(char c) {
     return c >= '0' && c <= '9';
 }
 
+char char_lower(char c) {
+    return STR__LOWER(c);
+}
+
+char char_upper(char c) {
+    return STR__UPPER(c);
+}
+
 // == INPUT STREAM =================================================
 
 instream_t istr_init(strview_t str) {
@@ -405,9 +1224,10 @@ char istr_prev_prev(instream_t *ctx) {
 }
 
 void istr_ignore(instream_t *ctx, char delim) {
-    while (!istr_is_finished(ctx) && *ctx->cur != delim) {
-        ctx->cur++;
-    }
+    usize rem = istr_remaining(ctx);
+    if (!rem) return;
+    const char *found = memchr(ctx->cur, delim, rem);
+    ctx->cur = found ? found : ctx->cur + rem;
 }
 
 void istr_ignore_and_skip(instream_t *ctx, char delim) {
@@ -582,9 +1402,7 @@ strview_t istr_get_view(instream_t *ctx, char delim) {
 strview_t istr_get_view_either(instream_t *ctx, strview_t chars) {
     if (!ctx || !ctx->cur) return STRV_EMPTY;
     const char *from = ctx->cur;
-    while (!istr_is_finished(ctx) && !strv_contains(chars, *ctx->cur)) {
-        ctx->cur++;
-    }
+    ctx->cur += str__find_either(ctx->cur, istr_remaining(ctx), chars);
 
     usize len = ctx->cur - from;
     return strv(from, len);
@@ -125,6 +125,14 @@ strview_t strv_init_str(str_t str);
 bool strv_is_empty(strview_t ctx);
 bool strv_equals(strview_t a, strview_t b);
 int strv_compare(strview_t a, strview_t b);
+// ascii case-insensitive versions of strv_equals/strv_compare
+bool strv_equals_nocase(strview_t a, strview_t b);
+int strv_compare_nocase(strview_t a, strview_t b);
+// fnv-1a hash, the nocase version hashes the ascii lowercase of the string
+u64 strv_hash(strview_t ctx);
+u64 strv_hash_nocase(strview_t ctx);
+// checks that the whole view is valid utf8 (no overlong forms, surrogates or truncated sequences)
+bool strv_is_utf8(strview_t ctx);
 
 char strv_front(strview_t ctx);
 char strv_back(strview_t ctx);
@@ -157,11 +165,37 @@ usize strv_find_either(strview_t ctx, strview_t chars, usize from);
 usize strv_rfind(strview_t ctx, char c, usize from_right);
 usize strv_rfind_view(strview_t ctx, strview_t view, usize from_right);
 
+// splits a view on any of the characters in delims without allocating:
+//     for (strv_split_t it = strv_split(text, strv("\n")); strv_split_next(&it);) {
+//         info("line: %v", it.value);
+//     }
+// consecutive delimiters produce empty values, a delimiter at the very end doesn't
+typedef struct strv_split_t strv_split_t;
+struct strv_split_t {
+    strview_t src;
+    strview_t delims;
+    strview_t value;
+    usize pos;
+};
+
+typedef struct strv_array_t strv_array_t;
+struct strv_array_t {
+    strview_t *items;
+    usize count;
+};
+
+strv_split_t strv_split(strview_t ctx, strview_t delims);
+bool strv_split_next(strv_split_t *it);
+// same as the iterator, but writes all the values in one contiguous array
+strv_array_t strv_split_all(arena_t *arena, strview_t ctx, strview_t delims);
+
 // == CTYPE ========================================================
 
 bool char_is_space(char c);
 bool char_is_alpha(char c);
 bool char_is_num(char c);
+char char_lower(char c);
+char char_upper(char c);
 
 // == INPUT STREAM =================================================
 
@@ -0,0 +1,256 @@
+// runs the colla benchmarks
+// usage: bench [filter] [-json <output.json>] [-samples <n>]
+
+#include "../build.c"
+#include "../bench.c"
+
+typedef struct text_data_t text_data_t;
+struct text_data_t {
+    strview_t text;
+    strview_t needle;
+    strview_t chars;
+};
+
+// a long line of lowercase words with what we look for only at the very end
+strview_t make_text(arena_t *arena, usize size, strview_t tail) {
+    char *buf = alloc(arena, char, size + tail.len + 1);
+    u32 seed = 0x12345678;
+    for (usize i = 0; i < size; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        u32 r = (seed >> 24) % 32;
+        buf[i] = r < 26 ? (char)('a' + r) : ' ';
+    }
+    memcpy(buf + size, tail.buf, tail.len);
+    return strv_init_len(buf, size + tail.len);
+}
+
+// == ARENA =====================================
+
+void bench_arena_alloc_small(bench_t *b, void *userdata) {
+    COLLA_UNUSED(userdata);
+    b->items = 1024;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        for (int k = 0; k < 1024; ++k) {
+            u64 *ptr = alloc(&scratch, u64, 4);
+            bench_do_not_optimise(ptr);
+        }
+    }
+}
+
+void bench_arena_alloc_nozero(bench_t *b, void *userdata) {
+    COLLA_UNUSED(userdata);
+    b->items = 1024;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        for (int k = 0; k < 1024; ++k) {
+            u8 *ptr = alloc(&scratch, u8, 256, ALLOC_NOZERO);
+            bench_do_not_optimise(ptr);
+        }
+    }
+}
+
+// == STRINGS ===================================
+
+void bench_strv_find(bench_t *b, void *userdata) {
+    text_data_t *data = userdata;
+    b->bytes = data->text.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        usize pos = strv_find(data->text, '!', 0);
+        bench_do_not_optimise(pos);
+    }
+}
+
+void bench_strv_find_view(bench_t *b, void *userdata) {
+    text_data_t *data = userdata;
+    b->bytes = data->text.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        usize pos = strv_find_view(data->text, data->needle, 0);
+        bench_do_not_optimise(pos);
+    }
+}
+
+void bench_strv_find_either(bench_t *b, void *userdata) {
+    text_data_t *data = userdata;
+    b->bytes = data->text.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        usize pos = strv_find_either(data->text, data->chars, 0);
+        bench_do_not_optimise(pos);
+    }
+}
+
+void bench_istr_get_num(bench_t *b, void *userdata) {
+    strview_t numbers = *(strview_t *)userdata;
+    b->bytes = numbers.len;
+    b->items = 1024;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        instream_t in = istr_init(numbers);
+        double sum = 0;
+        for (int k = 0; k < 1024; ++k) {
+            double value = 0;
+            istr_get_num(&in, &value);
+            istr_skip(&in, 1);
+            sum += value;
+        }
+        bench_do_not_optimise(sum);
+    }
+}
+
+// == PARSERS ===================================
+
+void bench_json_parse_str(bench_t *b, void *userdata) {
+    strview_t json = *(strview_t *)userdata;
+    b->bytes = json.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        json_t *root = json_parse_str(&scratch, json, JSON_DEFAULT);
+        bench_do_not_optimise(root);
+    }
+}
+
+void bench_ini_parse_str(bench_t *b, void *userdata) {
+    strview_t ini = *(strview_t *)userdata;
+    b->bytes = ini.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        ini_t parsed = ini_parse_str(&scratch, ini, NULL);
+        bench_do_not_optimise(parsed.tables);
+    }
+}
+
+// == NET =======================================
+
+void bench_sha1(bench_t *b, void *userdata) {
+    buffer_t data = *(buffer_t *)userdata;
+    b->bytes = data.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        sha1_t ctx = sha1_init();
+        sha1_result_t result = sha1(&ctx, data.data, data.len);
+        bench_do_not_optimise(result);
+    }
+}
+
+void bench_base64_encode(bench_t *b, void *userdata) {
+    buffer_t data = *(buffer_t *)userdata;
+    b->bytes = data.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        buffer_t encoded = base64_encode(&scratch, data);
+        bench_do_not_optimise(encoded.data);
+    }
+}
+
+void bench_base64_decode(bench_t *b, void *userdata) {
+    buffer_t data = *(buffer_t *)userdata;
+    b->bytes = data.len;
+    for (u64 i = 0; i < b->iterations; ++i) {
+        arena_t scratch = *b->arena;
+        buffer_t decoded = base64_decode(&scratch, data);
+        bench_do_not_optimise(decoded.data);
+    }
+}
+
+// == DATA ======================================
+
+strview_t make_numbers(arena_t *arena) {
+    outstream_t out = ostr_init(arena);
+    u32 seed = 42;
+    for (int i = 0; i < 1024; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        ostr_print(&out, "%d.%03u ", (int)(seed >> 20) - 2048, seed % 1000);
+    }
+    return strv(ostr_to_str(&out));
+}
+
+strview_t make_json(arena_t *arena) {
+    outstream_t out = ostr_init(arena);
+    ostr_puts(&out, strv("{ \"items\": [\n"));
+    for (int i = 0; i < 512; ++i) {
+        ostr_print(
+            &out,
+            "  { \"id\": %d, \"name\": \"item number %d\", \"price\": %d.%02d, \"tags\": [\"a\", \"b\", \"c\"], \"active\": %s, \"extra\": null }%s\n",
+            i, i, i * 3, i % 100, i & 1 ? "true" : "false", i == 511 ? "" : ","
+        );
+    }
+    ostr_puts(&out, strv("] }\n"));
+    return strv(ostr_to_str(&out));
+}
+
+strview_t make_ini(arena_t *arena) {
+    outstream_t out = ostr_init(arena);
+    for (int t = 0; t < 64; ++t) {
+        ostr_print(&out, "[table_%d]\n", t);
+        for (int k = 0; k < 16; ++k) {
+            ostr_print(&out, "key_%d = value number %d ; comment\n", k, t * 16 + k);
+        }
+        ostr_putc(&out, '\n');
+    }
+    return strv(ostr_to_str(&out));
+}
+
+int main(int argc, char **argv) {
+    colla_init(COLLA_OS);
+
+    strview_t filter = STRV_EMPTY;
+    strview_t json_path = STRV_EMPTY;
+    u32 samples = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        strview_t arg = strv(argv[i]);
+        if (strv_equals(arg, strv("-json")) && (i + 1) < argc) {
+            json_path = strv(argv[++i]);
+        }
+        else if (strv_equals(arg, strv("-samples")) && (i + 1) < argc) {
+            instream_t in = istr_init(strv(argv[++i]));
+            istr_get_u32(&in, &samples);
+        }
+        else {
+            filter = arg;
+        }
+    }
+
+    arena_t arena = arena_make(ARENA_VIRTUAL, GB(1));
+
+    // every input is built up front so none of it ends up in the timings
+    arena_t data_arena = arena_make(ARENA_VIRTUAL, GB(1));
+
+    text_data_t text = {
+        .text = make_text(&data_arena, KB(64), strv("needle!")),
+        .needle = strv("needle"),
+        .chars = strv("!?#"),
+    };
+    strview_t numbers = make_numbers(&data_arena);
+    strview_t json = make_json(&data_arena);
+    strview_t ini = make_ini(&data_arena);
+
+    buffer_t binary = {
+        .data = (u8 *)make_text(&data_arena, KB(16), STRV_EMPTY).buf,
+        .len = KB(16),
+    };
+    buffer_t encoded = base64_encode(&data_arena, binary);
+
+    bench_runner_t runner = bench_make(&arena, .samples = samples, .filter = filter);
+
+    bench_run(&runner, strv("arena_alloc_small"),  bench_arena_alloc_small,  NULL);
+    bench_run(&runner, strv("arena_alloc_nozero"), bench_arena_alloc_nozero, NULL);
+    bench_run(&runner, strv("strv_find"),          bench_strv_find,          &text);
+    bench_run(&runner, strv("strv_find_view"),     bench_strv_find_view,     &text);
+    bench_run(&runner, strv("strv_find_either"),   bench_strv_find_either,   &text);
+    bench_run(&runner, strv("istr_get_num"),       bench_istr_get_num,       &numbers);
+    bench_run(&runner, strv("json_parse_str"),     bench_json_parse_str,     &json);
+    bench_run(&runner, strv("ini_parse_str"),      bench_ini_parse_str,      &ini);
+    bench_run(&runner, strv("sha1"),               bench_sha1,               &binary);
+    bench_run(&runner, strv("base64_encode"),      bench_base64_encode,      &binary);
+    bench_run(&runner, strv("base64_decode"),      bench_base64_decode,      &encoded);
+
+    bench_print(&runner);
+
+    if (json_path.len && !bench_write_json(&runner, json_path)) {
+        err("couldn't write results to %v", json_path);
+    }
+
+    bench_cleanup(&runner);
+    arena_cleanup(&data_arena);
+    arena_cleanup(&arena);
+    colla_cleanup();
+}
@@ -0,0 +1,173 @@
+// checks that iniedit_t output parses back to what was set
+// usage: ini_edit_test [fuzz iterations]
+
+#include "../build.c"
+
+typedef struct edit_t edit_t;
+struct edit_t {
+    const char *table;
+    const char *key;
+    const char *value;
+};
+
+int failures = 0;
+
+// applies the edits, then checks every one of them (and the keys that were
+// already there) against a fresh parse of the output
+bool check_edits(arena_t scratch, strview_t text, edit_t *edits, usize count) {
+    iniedit_t edit = ini_edit_init(&scratch, text, NULL);
+    ini_t before = ini_parse_str(&scratch, text, NULL);
+
+    for (usize i = 0; i < count; ++i) {
+        ini_edit_set(&edit, strv(edits[i].table), strv(edits[i].key), strv(edits[i].value));
+    }
+
+    str_t out = ini_edit_to_str(&scratch, &edit);
+    ini_t after = ini_parse_str(&scratch, strv(out), NULL);
+
+    bool ok = true;
+
+    for (usize i = 0; i < count && ok; ++i) {
+        strview_t table = strv(edits[i].table);
+        initable_t *t = ini_get_table(&after, strv_is_empty(table) ? INI_ROOT : table);
+        inivalue_t *v = ini_get(t, strv(edits[i].key));
+        // the last time a key is set wins
+        strview_t want = strv(edits[i].value);
+        for (usize k = i + 1; k < count; ++k) {
+            if (strcmp(edits[k].table, edits[i].table) == 0 && strcmp(edits[k].key, edits[i].key) == 0) {
+                want = strv(edits[k].value);
+            }
+        }
+        ok = v && strv_equals(strv_trim_right(v->value), want);
+    }
+
+    for_each (t, before.tables) {
+        for_each (v, t->values) {
+            if (!ok) break;
+            bool edited = false;
+            for (usize i = 0; i < count; ++i) {
+                strview_t table = strv(edits[i].table);
+                edited |= strv_equals(strv_is_empty(table) ? INI_ROOT : table, t->name) && strv_equals(strv(edits[i].key), v->key);
+            }
+            inivalue_t *now = ini_get(ini_get_table(&after, t->name), v->key);
+            ok = edited || (now && strv_equals(now->value, v->value));
+        }
+    }
+
+    if (!ok) {
+        failures++;
+        print("---- failed, input:\n%v\n---- output:\n%v\n----\n", text, out);
+    }
+
+    return ok;
+}
+
+void test_empty_value_at_end(arena_t scratch) {
+    // the new key and the empty value are both patched at the end of the text
+    edit_t edits[] = {
+        { "b", "z", "22" },
+        { "b", "y", "abc def" },
+    };
+    check_edits(scratch, strv("[a]\nx = 1\n\n[b]\ny="), edits, arrlen(edits));
+}
+
+void test_edits(arena_t scratch) {
+    edit_t edits[] = {
+        { "server", "port", "9090" },
+        { "", "empty", "now" },
+        { "server", "timeout", "30" },
+        { "other", "y", "2" },
+        { "new", "a", "1" },
+        { "other2", "q", "z" },
+        { "new", "b", "2" },
+        { "server", "port", "9091" },
+    };
+    strview_t text = strv("# top\nname = root ; c\nempty =\n[server]\n; c\nport = 8080   ; the port\nhost = localhost\n\n[other]\nx = 1");
+    check_edits(scratch, text, edits, arrlen(edits));
+}
+
+void test_invalid_keys(arena_t scratch) {
+    iniedit_t edit = ini_edit_init(&scratch, strv("[t]\nk = 1\n"), NULL);
+    const char *bad[] = { "[x", "; c", "# c", "", "a = b", "a\nb" };
+    for (int i = 0; i < arrlen(bad); ++i) {
+        if (ini_edit_set(&edit, strv("t"), strv(bad[i]), strv("22"))) {
+            print("---- accepted invalid key \"%s\"\n", bad[i]);
+            failures++;
+        }
+    }
+
+    // surrounding spaces are trimmed, it's the same key
+    ini_edit_set(&edit, strv("t"), strv(" k "), strv("2"));
+    str_t out = ini_edit_to_str(&scratch, &edit);
+    if (!strv_equals(strv(out), strv("[t]\nk = 2\n"))) {
+        print("---- \" k \" was not the same as \"k\":\n%v\n", out);
+        failures++;
+    }
+}
+
+void fuzz(arena_t scratch, u32 iterations) {
+    const char *tables[] = { "", "a", "b", "c", "d" };
+    const char *keys[] = { "x", "y", "z", "w" };
+    const char *values[] = { "", "1", "22", "abc def", "v" };
+    const char *texts[] = {
+        "",
+        "[a]\nx = 1\n",
+        "[b]\ny=",
+        "r = 1\n[a]\nx =\n\n[b]\ny = 2 ; c\n",
+        "; only a comment",
+        "[a]\n\n[b]\nz = 3",
+    };
+
+    u32 seed = 0x2545f491;
+    for (u32 i = 0; i < iterations; ++i) {
+        edit_t edits[6];
+        usize count = 0;
+
+        seed = seed * 1664525u + 1013904223u;
+        strview_t text = strv(texts[(seed >> 16) % arrlen(texts)]);
+        seed = seed * 1664525u + 1013904223u;
+        usize wanted = 1 + (seed >> 16) % arrlen(edits);
+
+        for (usize k = 0; k < wanted; ++k) {
+            // a table that doesn't exist can't be created by an empty value
+            // that would parse back the same as a missing one
+            seed = seed * 1664525u + 1013904223u;
+            edits[count].table = tables[(seed >> 8) % arrlen(tables)];
+            edits[count].key = keys[(seed >> 16) % arrlen(keys)];
+            edits[count].value = values[1 + (seed >> 24) % (arrlen(values) - 1)];
+            count++;
+        }
+
+        if (!check_edits(scratch, text, edits, count)) {
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    colla_init(COLLA_OS);
+
+    u32 iterations = 20000;
+    if (argc > 1) {
+        instream_t in = istr_init(strv(argv[1]));
+        istr_get_u32(&in, &iterations);
+    }
+
+    arena_t arena = arena_make(ARENA_VIRTUAL, GB(1));
+
+    test_empty_value_at_end(arena);
+    test_edits(arena);
+    test_invalid_keys(arena);
+    fuzz(arena, iterations);
+
+    if (failures) {
+        err("%d checks failed", failures);
+    }
+    else {
+        info("all checks passed");
+    }
+
+    arena_cleanup(&arena);
+    colla_cleanup();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+// turns a binary log written with os_log_async_make(.binary = true) back into text
+// usage: log_decode <binary log>
+
+#include "../build.c"
+
+typedef struct record_t record_t;
+struct record_t {
+    u8 kind;
+    u8 level;
+    u64 id;
+    strview_t data;
+    u32 dropped;
+};
+
+typedef struct format_t format_t;
+struct format_t {
+    u64 id;
+    strview_t fmt;
+};
+
+// open addressing map from id to format string
+typedef struct format_map_t format_map_t;
+struct format_map_t {
+    format_t *items;
+    usize mask;
+};
+
+bool read_str(ibstream_t *in, strview_t *out) {
+    u16 len = 0;
+    if (!ibstr_get_u16(in, &len) || ibstr_remaining(in) < len) {
+        return false;
+    }
+    *out = strv_init_len((const char *)in->cur, len);
+    ibstr_skip(in, len);
+    return true;
+}
+
+bool read_record(ibstream_t *in, record_t *rec) {
+    *rec = (record_t){0};
+    if (!ibstr_get_u8(in, &rec->kind)) {
+        return false;
+    }
+
+    switch (rec->kind) {
+        case LOG__BIN_FORMAT:
+            return ibstr_get_u64(in, &rec->id) && read_str(in, &rec->data);
+        case LOG__BIN_LINE:
+            return ibstr_get_u8(in, &rec->level) && ibstr_get_u64(in, &rec->id) && read_str(in, &rec->data);
+        case LOG__BIN_DROP:
+            return ibstr_get_u32(in, &rec->dropped);
+        default: break;
+    }
+
+    return false;
+}
+
+format_t *map_get(format_map_t *map, u64 id) {
+    usize index = (usize)((id * 11400714819323198485ull) >> 32) & map->mask;
+    while (map->items[index].id && map->items[index].id != id) {
+        index = (index + 1) & map->mask;
+    }
+    return &map->items[index];
+}
+
+format_map_t collect_formats(arena_t *arena, buffer_t log) {
+    usize count = 0;
+    ibstream_t in = ibstr_init(log);
+    record_t rec = {0};
+    while (read_record(&in, &rec)) {
+        count += rec.kind == LOG__BIN_FORMAT;
+    }
+
+    usize capacity = 16;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+
+    format_map_t map = {
+        .items = alloc(arena, format_t, capacity),
+        .mask = capacity - 1,
+    };
+
+    in = ibstr_init(log);
+    while (read_record(&in, &rec)) {
+        if (rec.kind != LOG__BIN_FORMAT) continue;
+        format_t *fmt = map_get(&map, rec.id);
+        fmt->id = rec.id;
+        fmt->fmt = rec.data;
+    }
+
+    return map;
+}
+
+// prints a single specifier, returns false if the arguments ran out
+bool print_spec(ibstream_t *args, log__spec_t spec, strview_t spec_str) {
+    char fmt[64] = {0};
+    usize len = 0;
+
+    if (spec_str.len > 32) {
+        return false;
+    }
+
+    for (usize i = 0; i < spec_str.len; ++i) {
+        if (spec_str.buf[i] != '*') {
+            fmt[len++] = spec_str.buf[i];
+            continue;
+        }
+        i32 value = 0;
+        if (!ibstr_get_i32(args, &value)) {
+            return false;
+        }
+        len += fmt_buffer(fmt + len, sizeof(fmt) - len, "%d", value);
+    }
+
+    switch (spec.type) {
+        case LOG__ARG_I32:
+        {
+            i32 value = 0;
+            if (!ibstr_get_i32(args, &value)) return false;
+            print(fmt, value);
+            break;
+        }
+        case LOG__ARG_I64:
+        {
+            i64 value = 0;
+            if (!ibstr_get_i64(args, &value)) return false;
+            print(fmt, value);
+            break;
+        }
+        case LOG__ARG_F64:
+        {
+            double value = 0;
+            if (ibstr_read(args, &value, sizeof(value)) != sizeof(value)) return false;
+            print(fmt, value);
+            break;
+        }
+        case LOG__ARG_STR:
+        case LOG__ARG_STRV:
+        {
+            strview_t value = STRV_EMPTY;
+            if (!read_str(args, &value)) return false;
+            // the string was already cut to the precision, print it as a view
+            fmt[len - 1] = 'v';
+            print(fmt, value);
+            break;
+        }
+        case LOG__ARG_WRITE:
+            break;
+        default:
+            print(fmt);
+            break;
+    }
+
+    return true;
+}
+
+void print_line(u8 level, strview_t fmt, strview_t args) {
+    if (level != LOG_BASIC) {
+        print("[%s]: ", log__level_to_str(level));
+    }
+
+    ibstream_t in = ibstr_init((buffer_t){ .data = (u8 *)args.buf, .len = args.len });
+
+    usize i = 0;
+    while (i < fmt.len) {
+        usize next = strv_find(fmt, '%', i);
+        if (next == STR_NONE) {
+            next = fmt.len;
+        }
+
+        print("%v", strv_sub(fmt, i, next));
+        i = next;
+
+        if (i >= fmt.len) {
+            break;
+        }
+
+        log__spec_t spec = log__parse_spec(fmt.buf + i, fmt.len - i);
+        strview_t spec_str = strv_sub(fmt, i, i + spec.len);
+        if (!print_spec(&in, spec, spec_str)) {
+            // the arguments were cut off, print the rest as is
+            print("%v", strv_sub(fmt, i, SIZE_MAX));
+            break;
+        }
+
+        i += spec.len;
+    }
+
+    print("\n");
+}
+
+int main(int argc, char **argv) {
+    colla_init(COLLA_OS);
+
+    if (argc < 2) {
+        println("usage: %s <binary log>", argv[0]);
+        return 1;
+    }
+
+    arena_t arena = arena_make(ARENA_VIRTUAL, GB(1));
+
+    buffer_t log = os_file_read_all(&arena, strv(argv[1]));
+    if (log.len < 5 || memcmp(log.data, LOG__BIN_MAGIC, 4) != 0) {
+        err("%s is not a binary log", argv[1]);
+        return 1;
+    }
+
+    if (log.data[4] != LOG__BIN_VERSION) {
+        err("unsupported binary log version %u, expected %u", log.data[4], LOG__BIN_VERSION);
+        return 1;
+    }
+
+    log.data += 5;
+    log.len  -= 5;
+
+    format_map_t formats = collect_formats(&arena, log);
+
+    // the output can be big, don't write it line by line
+    fmt_set_flush_policy(FMT_FLUSH_SIZE, 0);
+
+    ibstream_t in = ibstr_init(log);
+    record_t rec = {0};
+    while (read_record(&in, &rec)) {
+        switch (rec.kind) {
+            case LOG__BIN_LINE:
+            {
+                format_t *fmt = map_get(&formats, rec.id);
+                if (!fmt->id) {
+                    print("[?]: unknown format %llx\n", rec.id);
+                    break;
+                }
+                print_line(rec.level, fmt->fmt, rec.data);
+                break;
+            }
+            case LOG__BIN_DROP:
+                print("[WARN]: %u log lines were dropped\n", rec.dropped);
+                break;
+            default: break;
+        }
+    }
+
+    if (!ibstr_is_finished(&in)) {
+        err("log is corrupted or truncated at offset %zu", ibstr_tell(&in) + 5);
+    }
+
+    arena_cleanup(&arena);
+    colla_cleanup();
+}
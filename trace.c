@@ -0,0 +1,223 @@
+#include "trace.h"
+#include "os.h"
+
+#define TRACE__DEFAULT_EVENTS (1 << 16)
+
+// end events have no name, the viewer closes the last open span
+typedef struct trace__event_t trace__event_t;
+struct trace__event_t {
+    const char *name;
+    u64 time;
+};
+
+typedef struct trace__thread_t trace__thread_t;
+struct trace__thread_t {
+    trace__thread_t *next;
+    trace__event_t *events;
+    usize alloc_size;
+    u32 tid;
+    u32 capacity;
+    // only written by the owning thread, published with release
+    volatile u32 count;
+    // spans that are open and recorded, there is always space for their ends
+    u32 depth;
+    // spans that are open but were dropped, their ends are dropped too
+    u32 skipped;
+    u32 dropped;
+};
+
+typedef struct trace__local_t trace__local_t;
+struct trace__local_t {
+    trace__thread_t *thread;
+    // the thread buffer is only valid for the trace_init it was made in
+    u32 generation;
+};
+
+struct {
+    volatile u32 enabled;
+    u32 generation;
+    u32 events_per_thread;
+    u32 next_tid;
+    u64 start;
+    os_lock_t lock;
+    trace__thread_t *threads;
+} trace__data = {0};
+
+static COLLA_THREAD_LOCAL trace__local_t trace__local = {0};
+
+bool trace_init(const trace_desc_t *desc) {
+#if COLLA_TCC
+    COLLA_UNUSED(desc);
+    err("tracing needs thread local storage, which isn't available with tcc");
+    return false;
+#else
+    if (atomic_load_u32(&trace__data.enabled, ATOMIC_RELAXED)) {
+        warn("trace already initialised");
+        return true;
+    }
+
+    trace__data.events_per_thread = desc && desc->events_per_thread ? desc->events_per_thread : TRACE__DEFAULT_EVENTS;
+    trace__data.next_tid = 1;
+    trace__data.start = os_now_ns();
+    trace__data.generation++;
+
+    atomic_store_u32(&trace__data.enabled, true, ATOMIC_RELEASE);
+    return true;
+#endif
+}
+
+void trace_cleanup(void) {
+    atomic_store_u32(&trace__data.enabled, false, ATOMIC_RELAXED);
+
+    os_lock_acquire(&trace__data.lock);
+    trace__thread_t *thread = trace__data.threads;
+    while (thread) {
+        trace__thread_t *next = thread->next;
+        os_release(thread, thread->alloc_size);
+        thread = next;
+    }
+    trace__data.threads = NULL;
+    trace__data.generation++;
+    os_lock_release(&trace__data.lock);
+}
+
+// the buffers don't come from an arena: arena commits are traced themselves
+trace__thread_t *trace__register_thread(void) {
+    u32 capacity = trace__data.events_per_thread;
+    usize size = sizeof(trace__thread_t) + (usize)capacity * sizeof(trace__event_t);
+
+    usize alloc_size = 0;
+    u8 *mem = os_reserve(size, &alloc_size);
+    if (!mem || !os_commit(mem, alloc_size / os_get_system_info().page_size)) {
+        err("couldn't allocate %zu bytes for the trace buffer", size);
+        if (mem) os_release(mem, alloc_size);
+        return NULL;
+    }
+
+    trace__thread_t *thread = (trace__thread_t *)mem;
+    memset(thread, 0, sizeof(*thread));
+    thread->events = (trace__event_t *)(mem + sizeof(trace__thread_t));
+    thread->alloc_size = alloc_size;
+    thread->capacity = capacity;
+
+    os_lock_acquire(&trace__data.lock);
+    thread->tid = trace__data.next_tid++;
+    thread->next = trace__data.threads;
+    trace__data.threads = thread;
+    trace__local.generation = trace__data.generation;
+    os_lock_release(&trace__data.lock);
+
+    trace__local.thread = thread;
+    return thread;
+}
+
+trace__thread_t *trace__get_thread(void) {
+    if (!atomic_load_u32(&trace__data.enabled, ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    if (trace__local.thread && trace__local.generation == trace__data.generation) {
+        return trace__local.thread;
+    }
+    return trace__register_thread();
+}
+
+void trace__push(trace__thread_t *thread, const char *name) {
+    u32 count = thread->count;
+    thread->events[count] = (trace__event_t){
+        .name = name,
+        .time = os_now_ns(),
+    };
+    atomic_store_u32(&thread->count, count + 1, ATOMIC_RELEASE);
+}
+
+void trace_begin(const char *name) {
+    trace__thread_t *thread = trace__get_thread();
+    if (!thread) {
+        return;
+    }
+
+    // keep space for this span's end and the ones already open
+    if (thread->skipped || (thread->count + thread->depth + 2) > thread->capacity) {
+        thread->skipped++;
+        thread->dropped++;
+        return;
+    }
+
+    trace__push(thread, name);
+    thread->depth++;
+}
+
+void trace_end(void) {
+    trace__thread_t *thread = trace__get_thread();
+    if (!thread) {
+        return;
+    }
+
+    if (thread->skipped) {
+        thread->skipped--;
+        return;
+    }
+
+    // more ends than begins, or the span started before trace_init
+    if (!thread->depth) {
+        return;
+    }
+
+    trace__push(thread, NULL);
+    thread->depth--;
+}
+
+str_t trace_to_json(arena_t *arena) {
+    outstream_t out = ostr_init(arena);
+    u64 dropped = 0;
+    bool first = true;
+
+    ostr_puts(&out, strv("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"));
+
+    // growing the arena below is traced, this makes sure the calling thread
+    // doesn't try to register itself while we hold the lock
+    trace__get_thread();
+
+    os_lock_acquire(&trace__data.lock);
+
+    for_each (thread, trace__data.threads) {
+        u32 count = atomic_load_u32(&thread->count, ATOMIC_ACQUIRE);
+        dropped += thread->dropped;
+
+        for (u32 i = 0; i < count; ++i) {
+            trace__event_t *ev = &thread->events[i];
+            // timestamps are in microseconds
+            u64 time = ev->time - trace__data.start;
+
+            if (!first) {
+                ostr_puts(&out, strv(",\n"));
+            }
+            first = false;
+
+            if (ev->name) {
+                ostr_print(&out, "{\"name\":\"%s\",\"ph\":\"B\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u}", ev->name, thread->tid, time / 1000, (u32)(time % 1000));
+            }
+            else {
+                ostr_print(&out, "{\"ph\":\"E\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u}", thread->tid, time / 1000, (u32)(time % 1000));
+            }
+        }
+    }
+
+    os_lock_release(&trace__data.lock);
+
+    ostr_puts(&out, strv("\n]}\n"));
+
+    if (dropped) {
+        warn("trace buffers were full, %llu spans were dropped", dropped);
+    }
+
+    return ostr_to_str(&out);
+}
+
+bool trace_write_json(strview_t filename) {
+    arena_t arena = arena_make(ARENA_VIRTUAL, GB(1));
+    str_t json = trace_to_json(&arena);
+    bool success = os_file_write_all_str(filename, strv(json));
+    arena_cleanup(&arena);
+    return success;
+}
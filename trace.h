@@ -0,0 +1,55 @@
+#ifndef COLLA_TRACE_H
+#define COLLA_TRACE_H
+
+#include "core.h"
+#include "str.h"
+#include "arena.h"
+
+// timeline of nested spans, every thread records into its own buffer. the
+// result is chrome trace event json, open it in ui.perfetto.dev or
+// chrome://tracing
+//
+// the macros are compiled out unless COLLA_TRACE is defined to 1 before
+// including colla, the functions are always there:
+//
+//     TRACE_SCOPE("load level") {
+//         ...
+//     }
+//
+// don't return or break out of a TRACE_SCOPE, the span would never end
+
+#ifndef COLLA_TRACE
+#define COLLA_TRACE 0
+#endif
+
+typedef struct trace_desc_t trace_desc_t;
+struct trace_desc_t {
+    u32 events_per_thread; // defaults to 1 << 16, once a thread is full its new spans are dropped
+};
+
+// [ u32 events_per_thread ]
+#define trace_make(...) trace_init(&(trace_desc_t){ __VA_ARGS__ })
+
+bool trace_init(const trace_desc_t *desc);
+// every thread has to be done tracing before this is called
+void trace_cleanup(void);
+
+// name is not copied, use string literals. it must not contain quotes
+void trace_begin(const char *name);
+void trace_end(void);
+
+// spans that are still being recorded while this runs might be missing
+str_t trace_to_json(arena_t *arena);
+bool trace_write_json(strview_t filename);
+
+#if COLLA_TRACE
+    #define TRACE_BEGIN(name) trace_begin(name)
+    #define TRACE_END()       trace_end()
+    #define TRACE_SCOPE(name) for (int trace__scope = (trace_begin(name), 0); !trace__scope; trace__scope = (trace_end(), 1))
+#else
+    #define TRACE_BEGIN(name) ((void)0)
+    #define TRACE_END()       ((void)0)
+    #define TRACE_SCOPE(name)
+#endif
+
+#endif
@@ -1,5 +1,7 @@
 #include "../net.h"
 #include "../os.h"
+#include "../trace.h"
+#include "../metrics.h"
 
 #include <windows.h>
 
@@ -54,6 +56,9 @@ http_res_t http_request(http_request_desc_t *req) {
     bool success = false;
     http_res_t res = {0};
     arena_t arena_before = *req->arena;
+    u64 start = os_now_ns();
+
+    TRACE_BEGIN("http_request");
 
     if (!http_win.internet) {
         err("net_init has not been called");
@@ -197,6 +202,18 @@ failed:
     if (request) InternetCloseHandle(request);
     if (connection) InternetCloseHandle(connection);
     if (!success) *req->arena = arena_before;
+    TRACE_END();
+
+    metrics_add(metrics_colla.http_requests, 1);
+    metrics_record(metrics_colla.http_duration_ns, os_now_ns() - start);
+    if (success) {
+        metrics_add(metrics_colla.net_sent_bytes, req->body.len);
+        metrics_add(metrics_colla.net_received_bytes, res.body.len);
+    }
+    else {
+        metrics_add(metrics_colla.http_failures, 1);
+    }
+
     return res;
 }
 
@@ -286,11 +303,19 @@ bool sk_connect(socket_t sock, const char *server, u16 server_port) {
 }
 
 int sk_send(socket_t sock, const void *buf, int len) {
-    return send(sock, (const char *)buf, len, 0);
+    int sent = send(sock, (const char *)buf, len, 0);
+    if (sent > 0) {
+        metrics_add(metrics_colla.net_sent_bytes, (u64)sent);
+    }
+    return sent;
 }
 
 int sk_recv(socket_t sock, void *buf, int len) {
-    return recv(sock, (char *)buf, len, 0);
+    int received = recv(sock, (char *)buf, len, 0);
+    if (received > 0) {
+        metrics_add(metrics_colla.net_received_bytes, (u64)received);
+    }
+    return received;
 }
 
 int sk_poll(skpoll_t *to_poll, int num_to_poll, int timeout) {
@@ -34,31 +34,158 @@ struct os_entity_t {
 struct {
     arena_t arena;
     os_system_info_t info;
+    os_lock_t entity_lock; // protects entity_free and arena
     os_entity_t *entity_free;
+    u32 entity_generation; // bumped by os_cleanup, stale thread caches are dropped
     oshandle_t hstdout;
     oshandle_t hstdin;
+    bool use_escapes;
 } w32_data = {0};
 
-os_entity_t *os__win_alloc_entity(os_entity_kind_e kind) {
-    os_entity_t *entity = w32_data.entity_free;
-    if (entity) {
+// entities are handed out from a small per-thread cache, the global free list
+// is only touched (under entity_lock) to refill or trim it a batch at a time.
+// tcc doesn't have thread locals, so there it always goes through the lock
+#define OS__ENTITY_CACHE_SIZE (32)
+#define OS__ENTITY_BATCH      (OS__ENTITY_CACHE_SIZE / 2)
+
+typedef struct os__win_entity_cache_t os__win_entity_cache_t;
+struct os__win_entity_cache_t {
+    os_entity_t *head;
+    u32 count;
+    u32 generation;
+};
+
+#if !COLLA_TCC
+static COLLA_THREAD_LOCAL os__win_entity_cache_t os__win_entity_cache = {0};
+
+os__win_entity_cache_t *os__win_get_entity_cache(void) {
+    os__win_entity_cache_t *cache = &os__win_entity_cache;
+    // the entities it had were freed with the old os arena
+    if (cache->generation != w32_data.entity_generation) {
+        *cache = (os__win_entity_cache_t){ .generation = w32_data.entity_generation };
+    }
+    return cache;
+}
+#endif
+
+// moves up to count entities from the global list to the cache, making new
+// ones if there aren't enough. must be called with entity_lock held
+void os__win_take_entities(os__win_entity_cache_t *cache, u32 count) {
+    while (count && w32_data.entity_free) {
+        os_entity_t *entity = w32_data.entity_free;
         list_pop(w32_data.entity_free);
+        list_push(cache->head, entity);
+        cache->count++;
+        count--;
     }
-    else {
-        entity = alloc(&w32_data.arena, os_entity_t);
+
+    if (!count) {
+        return;
+    }
+
+    os_entity_t *slab = alloc(&w32_data.arena, os_entity_t, count);
+    for (u32 i = 0; i < count; ++i) {
+        list_push(cache->head, &slab[i]);
     }
+    cache->count += count;
+}
+
+os_entity_t *os__win_alloc_entity(os_entity_kind_e kind) {
+    os_entity_t *entity = NULL;
+
+#if COLLA_TCC
+    os__win_entity_cache_t cache = {0};
+    os_lock_acquire(&w32_data.entity_lock);
+    os__win_take_entities(&cache, 1);
+    os_lock_release(&w32_data.entity_lock);
+    entity = cache.head;
+#else
+    os__win_entity_cache_t *cache = os__win_get_entity_cache();
+    if (!cache->head) {
+        os_lock_acquire(&w32_data.entity_lock);
+        os__win_take_entities(cache, OS__ENTITY_BATCH);
+        os_lock_release(&w32_data.entity_lock);
+    }
+    entity = cache->head;
+    list_pop(cache->head);
+    cache->count--;
+#endif
+
+    entity->next = NULL;
     entity->kind = kind;
     return entity;
 }
 
 void os__win_free_entity(os_entity_t *entity) {
     entity->kind = OS_KIND_NULL;
+
+#if COLLA_TCC
+    os_lock_acquire(&w32_data.entity_lock);
     list_push(w32_data.entity_free, entity);
+    os_lock_release(&w32_data.entity_lock);
+#else
+    os__win_entity_cache_t *cache = os__win_get_entity_cache();
+    list_push(cache->head, entity);
+    cache->count++;
+
+    if (cache->count <= OS__ENTITY_CACHE_SIZE) {
+        return;
+    }
+
+    // give half back, so a thread that only frees (e.g. joining threads
+    // launched somewhere else) doesn't keep everything to itself
+    os_lock_acquire(&w32_data.entity_lock);
+    for (u32 i = 0; i < OS__ENTITY_BATCH; ++i) {
+        os_entity_t *free_entity = cache->head;
+        list_pop(cache->head);
+        list_push(w32_data.entity_free, free_entity);
+    }
+    cache->count -= OS__ENTITY_BATCH;
+    os_lock_release(&w32_data.entity_lock);
+#endif
+}
+
+// called by every thread launched with os_thread_launch before it exits,
+// otherwise the entities in its cache would be lost for good
+void os__win_thread_exit(void) {
+#if !COLLA_TCC
+    os__win_entity_cache_t *cache = os__win_get_entity_cache();
+    if (!cache->head) {
+        return;
+    }
+
+    os_lock_acquire(&w32_data.entity_lock);
+    while (cache->head) {
+        os_entity_t *entity = cache->head;
+        list_pop(cache->head);
+        list_push(w32_data.entity_free, entity);
+    }
+    os_lock_release(&w32_data.entity_lock);
+
+    cache->count = 0;
+#endif
 }
 
+// implemented in the futex section, called by os_init
+void os__win_futex_load(void);
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+
 void os_init(void) {
     SetConsoleOutputCP(CP_UTF8);
 
+    // with escape codes the colours are part of the text, so a log line can
+    // be written with a single call. this fails if stdout is not a console
+    HANDLE hconsole = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD console_mode = 0;
+    if (GetConsoleMode(hconsole, &console_mode)) {
+        w32_data.use_escapes = SetConsoleMode(hconsole, console_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    }
+
+    os__win_futex_load();
+
     SYSTEM_INFO sysinfo = {0};
     GetSystemInfo(&sysinfo);
 
@@ -88,13 +215,18 @@ void os_init(void) {
 }
 
 void os_cleanup(void) {
+    os_log_async_cleanup();
+
     os_file_close(w32_data.hstdout);
     os_file_close(w32_data.hstdin);
 
     arena_cleanup(&w32_data.arena);
+    w32_data.entity_free = NULL;
+    w32_data.entity_generation++;
 }
 
 void os_abort(int code) {
+    os_log_flush();
     ExitProcess(code);
 }
 
@@ -155,7 +287,30 @@ os_system_info_t os_get_system_info(void) {
 	return w32_data.info;
 }
 
+bool os__log_use_escapes(void) {
+    return w32_data.use_escapes;
+}
+
+oshandle_t os__event_create(void) {
+    HANDLE event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    return (oshandle_t){ .data = (uptr)event };
+}
+
+void os__event_signal(oshandle_t event) {
+    if (!os_handle_valid(event)) return;
+    SetEvent((HANDLE)event.data);
+}
+
+void os__event_free(oshandle_t event) {
+    if (!os_handle_valid(event)) return;
+    CloseHandle((HANDLE)event.data);
+}
+
 void os_log_set_colour(os_log_colour_e colour) {
+    // the colour is applied to whatever is written next, so anything
+    // still buffered needs to go out with the previous colour
+    fmt_flush();
+
     WORD attribute = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
     switch (colour) {
         case LOG_COL_BLACK:   attribute = 0;                                   break;
@@ -275,6 +430,57 @@ usize os_file_write(oshandle_t handle, const void *buf, usize len) {
     return (usize)written;
 }
 
+// positioned read/write on a synchronous handle, the offset in the OVERLAPPED
+// is used instead of the file pointer
+bool os__win_rw_at(oshandle_t handle, void *buf, usize len, u64 offset, bool write, usize *out_done) {
+    u8 *ptr = buf;
+    usize done = 0;
+    bool success = true;
+
+    while (done < len) {
+        DWORD chunk = (DWORD)MIN(len - done, 0xFFFFFFFF);
+        DWORD transferred = 0;
+        u64 pos = offset + done;
+        OVERLAPPED ov = {
+            .Offset = (DWORD)pos,
+            .OffsetHigh = (DWORD)(pos >> 32),
+        };
+
+        BOOL result = write ?
+            WriteFile((HANDLE)handle.data, ptr + done, chunk, &transferred, &ov) :
+            ReadFile((HANDLE)handle.data, ptr + done, chunk, &transferred, &ov);
+
+        if (!result) {
+            // reading past the end of the file is not an error
+            success = !write && GetLastError() == ERROR_HANDLE_EOF;
+            break;
+        }
+
+        done += transferred;
+
+        if (transferred == 0) {
+            break;
+        }
+    }
+
+    if (out_done) *out_done = done;
+    return success;
+}
+
+usize os_file_read_at(oshandle_t handle, void *buf, usize len, u64 offset) {
+    if (!os_handle_valid(handle)) return 0;
+    usize read = 0;
+    os__win_rw_at(handle, buf, len, offset, false, &read);
+    return read;
+}
+
+usize os_file_write_at(oshandle_t handle, const void *buf, usize len, u64 offset) {
+    if (!os_handle_valid(handle)) return 0;
+    usize written = 0;
+    os__win_rw_at(handle, (void *)buf, len, offset, true, &written);
+    return written;
+}
+
 bool os_file_seek(oshandle_t handle, usize offset) {
     if (!os_handle_valid(handle)) return false;
     LARGE_INTEGER offset_large = {
@@ -309,6 +515,17 @@ usize os_file_size(oshandle_t handle) {
     return result == TRUE ? (usize)size.QuadPart : 0;
 }
 
+bool os_file_set_size(oshandle_t handle, u64 size) {
+    if (!os_handle_valid(handle)) return false;
+    LARGE_INTEGER offset = {
+        .QuadPart = (LONGLONG)size,
+    };
+    if (!SetFilePointerEx((HANDLE)handle.data, offset, NULL, FILE_BEGIN)) {
+        return false;
+    }
+    return SetEndOfFile((HANDLE)handle.data);
+}
+
 bool os_file_is_finished(oshandle_t handle) {
     if (!os_handle_valid(handle)) return 0;
 
@@ -335,6 +552,485 @@ u64 os_file_time_fp(oshandle_t handle) {
     return (u64)utime.QuadPart;
 }
 
+// == FILE MAPPING ==============================
+
+typedef struct {
+    ULONG_PTR VirtualAddress;
+    SIZE_T NumberOfBytes;
+} os__win_memory_range_t;
+
+typedef BOOL (WINAPI os__win_prefetch_fn)(HANDLE, ULONG_PTR, os__win_memory_range_t *, ULONG);
+
+// PrefetchVirtualMemory is only available from windows 8, so it is loaded at runtime
+void os__win_prefetch(void *ptr, usize size) {
+    static os__win_prefetch_fn *prefetch = NULL;
+    static bool loaded = false;
+
+    if (!loaded) {
+        HMODULE kernel = GetModuleHandleA("kernel32.dll");
+        prefetch = kernel ? (os__win_prefetch_fn *)GetProcAddress(kernel, "PrefetchVirtualMemory") : NULL;
+        loaded = true;
+    }
+
+    if (prefetch) {
+        os__win_memory_range_t range = { .VirtualAddress = (ULONG_PTR)ptr, .NumberOfBytes = size };
+        prefetch(GetCurrentProcess(), 1, &range, 0);
+    }
+}
+
+os_file_map_t os_file_map(strview_t path, os_map_flags_e flags) {
+    OS_SMALL_SCRATCH();
+
+    os_file_map_t out = {0};
+
+    tstr_t full_path = os_file_fullpath(&scratch, path);
+
+    DWORD attributes = FILE_ATTRIBUTE_NORMAL;
+    if (flags & OS_MAP_SEQUENTIAL) {
+        attributes |= FILE_FLAG_SEQUENTIAL_SCAN;
+    }
+
+    HANDLE file = CreateFile(
+        full_path.buf,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        attributes,
+        NULL
+    );
+
+    if (file == INVALID_HANDLE_VALUE) {
+        err("couldn't open file %v for mapping", path);
+        return out;
+    }
+
+    out.file.data = (uptr)file;
+
+    LARGE_INTEGER file_size = {0};
+    if (!GetFileSizeEx(file, &file_size)) {
+        err("couldn't get the size of %v", path);
+        os_file_unmap(&out);
+        return out;
+    }
+
+    // an empty file can't be mapped, but it's still a valid file
+    if (file_size.QuadPart == 0) {
+        return out;
+    }
+
+    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        err("couldn't create file mapping for %v: %v", path, os_get_error_string(os_get_last_error()));
+        os_file_unmap(&out);
+        return out;
+    }
+
+    out.mapping.data = (uptr)mapping;
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        err("couldn't map view of %v: %v", path, os_get_error_string(os_get_last_error()));
+        os_file_unmap(&out);
+        return out;
+    }
+
+    out.data.data = view;
+    out.data.len = (usize)file_size.QuadPart;
+
+    if (flags & OS_MAP_WILLNEED) {
+        os__win_prefetch(out.data.data, out.data.len);
+    }
+
+    return out;
+}
+
+void os_file_unmap(os_file_map_t *map) {
+    if (!map) return;
+
+    if (map->data.data) {
+        UnmapViewOfFile(map->data.data);
+    }
+    if (os_handle_valid(map->mapping)) {
+        CloseHandle((HANDLE)map->mapping.data);
+    }
+    if (os_handle_valid(map->file)) {
+        CloseHandle((HANDLE)map->file.data);
+    }
+
+    *map = (os_file_map_t){0};
+}
+
+bool os_file_map_is_valid(os_file_map_t *map) {
+    return map && os_handle_valid(map->file);
+}
+
+// == ASYNC IO ==================================
+
+#define OS__AIO_QUIT_KEY 1
+
+struct os_aio_t {
+    HANDLE work_port;
+    HANDLE done_port;
+    oshandle_t *threads;
+    u32 thread_count;
+    volatile LONG pending;
+};
+
+int os__win_aio_worker(u64 thread_id, void *userdata) {
+    COLLA_UNUSED(thread_id);
+    os_aio_t *aio = userdata;
+
+    while (true) {
+        DWORD bytes = 0;
+        ULONG_PTR key = 0;
+        OVERLAPPED *ov = NULL;
+
+        if (!GetQueuedCompletionStatus(aio->work_port, &bytes, &key, &ov, INFINITE)) {
+            continue;
+        }
+
+        if (key == OS__AIO_QUIT_KEY) {
+            break;
+        }
+
+        os_aio_req_t *req = (os_aio_req_t *)ov;
+        req->failed = !os__win_rw_at(req->file, req->buf, req->len, req->offset, req->op == OS_AIO_WRITE, &req->result);
+        atomic_store_u32(&req->done, true, ATOMIC_RELEASE);
+
+        PostQueuedCompletionStatus(aio->done_port, 0, 0, (OVERLAPPED *)req);
+    }
+
+    return 0;
+}
+
+os_aio_t *os_aio_init(arena_t *arena, const os_aio_desc_t *desc) {
+    os_aio_desc_t opts = desc ? *desc : (os_aio_desc_t){0};
+    u32 thread_count = opts.thread_count ? opts.thread_count : w32_data.info.processor_count * 2;
+    thread_count = MAX(thread_count, 1);
+
+    os_aio_t *aio = alloc(arena, os_aio_t);
+    aio->threads = alloc(arena, oshandle_t, thread_count);
+
+    aio->work_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+    aio->done_port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 0);
+
+    if (!aio->work_port || !aio->done_port) {
+        err("couldn't create io completion ports: %v", os_get_error_string(os_get_last_error()));
+        if (aio->work_port) CloseHandle(aio->work_port);
+        if (aio->done_port) CloseHandle(aio->done_port);
+        return NULL;
+    }
+
+    for (u32 i = 0; i < thread_count; ++i) {
+        aio->threads[i] = os_thread_launch(os__win_aio_worker, aio);
+        if (!os_handle_valid(aio->threads[i])) {
+            err("couldn't launch async io thread");
+            break;
+        }
+        aio->thread_count++;
+    }
+
+    if (aio->thread_count == 0) {
+        os_aio_cleanup(aio);
+        return NULL;
+    }
+
+    return aio;
+}
+
+void os_aio_cleanup(os_aio_t *aio) {
+    if (!aio) return;
+
+    while (os_aio_pending(aio) > 0) {
+        os_aio_wait(aio, 1, OS_WAIT_INFINITE);
+    }
+
+    for (u32 i = 0; i < aio->thread_count; ++i) {
+        PostQueuedCompletionStatus(aio->work_port, 0, OS__AIO_QUIT_KEY, NULL);
+    }
+
+    for (u32 i = 0; i < aio->thread_count; ++i) {
+        os_thread_join(aio->threads[i], NULL);
+    }
+
+    CloseHandle(aio->work_port);
+    CloseHandle(aio->done_port);
+
+    *aio = (os_aio_t){0};
+}
+
+usize os_aio_submit(os_aio_t *aio, os_aio_req_t *reqs, usize count) {
+    if (!aio) return 0;
+
+    for (usize i = 0; i < count; ++i) {
+        os_aio_req_t *req = &reqs[i];
+        req->result = 0;
+        req->failed = false;
+        req->done = false;
+
+        InterlockedIncrement(&aio->pending);
+        if (!PostQueuedCompletionStatus(aio->work_port, 0, 0, (OVERLAPPED *)req)) {
+            InterlockedDecrement(&aio->pending);
+            err("couldn't submit async io request: %v", os_get_error_string(os_get_last_error()));
+            return i;
+        }
+    }
+
+    return count;
+}
+
+usize os_aio_wait(os_aio_t *aio, usize min_count, u32 milliseconds) {
+    if (!aio) return 0;
+
+    usize completed = 0;
+    OVERLAPPED_ENTRY entries[64];
+    u64 deadline = os_now_ns() + (u64)milliseconds * 1000000ull;
+
+    while (true) {
+        // block only until min_count requests are done, after that just
+        // collect whatever is already there
+        DWORD timeout = 0;
+        if (completed < min_count) {
+            if (milliseconds == OS_WAIT_INFINITE) {
+                timeout = INFINITE;
+            }
+            else {
+                u64 now = os_now_ns();
+                timeout = now < deadline ? (DWORD)((deadline - now + 999999ull) / 1000000ull) : 0;
+            }
+        }
+        ULONG removed = 0;
+
+        if (!GetQueuedCompletionStatusEx(aio->done_port, entries, arrlen(entries), &removed, timeout, FALSE)) {
+            break;
+        }
+
+        for (ULONG i = 0; i < removed; ++i) {
+            os_aio_req_t *req = (os_aio_req_t *)entries[i].lpOverlapped;
+            InterlockedDecrement(&aio->pending);
+            if (req->callback) {
+                req->callback(req);
+            }
+        }
+
+        completed += removed;
+    }
+
+    return completed;
+}
+
+usize os_aio_pending(os_aio_t *aio) {
+    return aio ? (usize)InterlockedCompareExchange(&aio->pending, 0, 0) : 0;
+}
+
+// == WATCH =====================================
+
+#define OS__WATCH_BUFFER_SIZE (KB(64))
+
+struct os_watch_t {
+    HANDLE dir;
+    HANDLE event;
+    OVERLAPPED ov;
+    DWORD *buffer;
+    bool recursive;
+    bool pending;
+    // only set when watching a single file
+    str_t file_name;
+};
+
+bool os__watch_issue(os_watch_t *watch) {
+    DWORD filter =
+        FILE_NOTIFY_CHANGE_FILE_NAME |
+        FILE_NOTIFY_CHANGE_DIR_NAME  |
+        FILE_NOTIFY_CHANGE_LAST_WRITE |
+        FILE_NOTIFY_CHANGE_SIZE |
+        FILE_NOTIFY_CHANGE_CREATION;
+
+    ResetEvent(watch->event);
+    watch->ov = (OVERLAPPED){ .hEvent = watch->event };
+
+    watch->pending = ReadDirectoryChangesW(
+        watch->dir,
+        watch->buffer,
+        OS__WATCH_BUFFER_SIZE,
+        watch->recursive,
+        filter,
+        NULL,
+        &watch->ov,
+        NULL
+    );
+
+    return watch->pending;
+}
+
+os_watch_t *os_watch_open(arena_t *arena, strview_t path, bool recursive) {
+    OS_SMALL_SCRATCH();
+
+    strview_t dir_path = path;
+    strview_t file_name = STRV_EMPTY;
+
+    tstr_t winpath = strv_to_tstr(&scratch, path);
+    DWORD attributes = GetFileAttributes(winpath.buf);
+    if (attributes == INVALID_FILE_ATTRIBUTES) {
+        err("couldn't watch %v, it doesn't exist", path);
+        return NULL;
+    }
+
+    // files are watched through their directory
+    if (!(attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        strview_t name, ext;
+        os_file_split_path(path, &dir_path, &name, &ext);
+        file_name = strv(name.buf, name.len + ext.len);
+        if (strv_is_empty(dir_path)) {
+            dir_path = strv(".");
+        }
+        recursive = false;
+    }
+
+    tstr_t windir = strv_to_tstr(&scratch, dir_path);
+    HANDLE dir = CreateFile(
+        windir.buf,
+        FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        NULL
+    );
+
+    if (dir == INVALID_HANDLE_VALUE) {
+        err("couldn't open %v for watching: %v", dir_path, os_get_error_string(os_get_last_error()));
+        return NULL;
+    }
+
+    os_watch_t *watch = alloc(arena, os_watch_t);
+    watch->dir = dir;
+    watch->event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    watch->buffer = alloc(arena, DWORD, OS__WATCH_BUFFER_SIZE / sizeof(DWORD));
+    watch->recursive = recursive;
+    watch->file_name = str(arena, file_name);
+
+    if (!watch->event || !os__watch_issue(watch)) {
+        err("couldn't start watching %v: %v", path, os_get_error_string(os_get_last_error()));
+        os_watch_close(watch);
+        return NULL;
+    }
+
+    return watch;
+}
+
+void os_watch_close(os_watch_t *watch) {
+    if (!watch) return;
+
+    if (watch->dir && watch->dir != INVALID_HANDLE_VALUE) {
+        if (watch->pending) {
+            CancelIo(watch->dir);
+            // wait for the cancellation, the buffer must outlive the request
+            DWORD bytes = 0;
+            GetOverlappedResult(watch->dir, &watch->ov, &bytes, TRUE);
+        }
+        CloseHandle(watch->dir);
+    }
+    if (watch->event) {
+        CloseHandle(watch->event);
+    }
+
+    watch->dir = INVALID_HANDLE_VALUE;
+    watch->event = NULL;
+}
+
+bool os_watch_is_valid(os_watch_t *watch) {
+    return watch && watch->dir != INVALID_HANDLE_VALUE;
+}
+
+oshandle_t os_watch_handle(os_watch_t *watch) {
+    if (!os_watch_is_valid(watch)) return os_handle_zero();
+    return (oshandle_t){ .data = (uptr)watch->event };
+}
+
+os_watch_events_t os_watch_read(arena_t *arena, os_watch_t *watch) {
+    os_watch_events_t out = {0};
+
+    if (!os_watch_is_valid(watch)) {
+        return out;
+    }
+
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(watch->dir, &watch->ov, &bytes, FALSE)) {
+        if (GetLastError() != ERROR_IO_INCOMPLETE) {
+            err("watch failed: %v", os_get_error_string(os_get_last_error()));
+        }
+        return out;
+    }
+
+    watch->pending = false;
+
+    // the buffer was too small for all the changes
+    if (bytes == 0) {
+        out.overflow = true;
+    }
+
+    usize capacity = bytes / sizeof(FILE_NOTIFY_INFORMATION) + 1;
+    out.events = alloc(arena, os_watch_event_t, capacity, ALLOC_NOZERO);
+
+    u8 *cur = (u8 *)watch->buffer;
+    u8 *end = cur + bytes;
+
+    while (bytes && cur < end) {
+        FILE_NOTIFY_INFORMATION *info = (FILE_NOTIFY_INFORMATION *)cur;
+
+        os_watch_kind_e kind = OS_WATCH_MODIFIED;
+        switch (info->Action) {
+            case FILE_ACTION_ADDED:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                kind = OS_WATCH_CREATED;
+                break;
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME:
+                kind = OS_WATCH_DELETED;
+                break;
+            default: break;
+        }
+
+        arena_t before = *arena;
+        str16_t name16 = str16_init((u16 *)info->FileName, info->FileNameLength / sizeof(WCHAR));
+        str_t path = str_from_str16(arena, name16);
+        str_replace(&path, '\\', '/');
+
+        bool keep = true;
+
+        // ntfs names are case insensitive, the file may be saved as FILE.TXT
+        if (!str_is_empty(watch->file_name) && !strv_equals_nocase(strv(path), strv(watch->file_name))) {
+            keep = false;
+        }
+
+        // editors tend to write the same file several times in a row
+        if (keep && out.count) {
+            os_watch_event_t *last = &out.events[out.count - 1];
+            keep = last->kind != kind || !str_equals(last->path, path);
+        }
+
+        if (keep) {
+            out.events[out.count++] = (os_watch_event_t){ .kind = kind, .path = path };
+        }
+        else {
+            *arena = before;
+        }
+
+        if (!info->NextEntryOffset) {
+            break;
+        }
+        cur += info->NextEntryOffset;
+    }
+
+    if (!os__watch_issue(watch)) {
+        err("couldn't keep watching: %v", os_get_error_string(os_get_last_error()));
+    }
+
+    return out;
+}
+
 // == DIR WALKER ================================
 
 typedef struct dir_t {
@@ -419,6 +1115,267 @@ dir_entry_t *os_dir_next(arena_t *arena, dir_t *dir) {
     return &dir->cur_entry;
 }
 
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH 2
+#endif
+
+#define OS__WALK_CHUNK_SIZE 1024
+
+typedef struct os__walk_dir_t os__walk_dir_t;
+struct os__walk_dir_t {
+    os__walk_dir_t *next;
+    str_t path;
+};
+
+typedef struct os__walk_chunk_t os__walk_chunk_t;
+struct os__walk_chunk_t {
+    os__walk_chunk_t *next;
+    usize count;
+    os_walk_entry_t entries[OS__WALK_CHUNK_SIZE];
+};
+
+typedef struct os__walk_t os__walk_t;
+
+typedef struct os__walk_worker_t os__walk_worker_t;
+struct os__walk_worker_t {
+    os__walk_t *walk;
+    // the entries (only directories with a callback) and the queued directories
+    arena_t arena;
+    // rewound for every directory and entry, paths can be up to ~32k characters
+    arena_t scratch;
+    os__walk_chunk_t *chunks;
+    usize count;
+};
+
+struct os__walk_t {
+    os_walk_desc_t desc;
+    CRITICAL_SECTION lock;
+    HANDLE semaphore;
+    os__walk_dir_t *queue;
+    // directories either in the queue or being read
+    usize outstanding;
+    u32 thread_count;
+    bool done;
+};
+
+void os__walk_push_dir(os__walk_t *walk, os__walk_dir_t *dir) {
+    EnterCriticalSection(&walk->lock);
+    list_push(walk->queue, dir);
+    walk->outstanding++;
+    LeaveCriticalSection(&walk->lock);
+    ReleaseSemaphore(walk->semaphore, 1, NULL);
+}
+
+void os__walk_emit(os__walk_worker_t *worker, os_walk_entry_t *entry) {
+    os_walk_desc_t *desc = &worker->walk->desc;
+    if (desc->callback) {
+        desc->callback(entry, desc->userdata);
+        return;
+    }
+
+    os__walk_chunk_t *chunk = worker->chunks;
+    if (!chunk || chunk->count == OS__WALK_CHUNK_SIZE) {
+        chunk = alloc(&worker->arena, os__walk_chunk_t, 1, ALLOC_NOZERO);
+        chunk->count = 0;
+        list_push(worker->chunks, chunk);
+    }
+
+    chunk->entries[chunk->count++] = *entry;
+    worker->count++;
+}
+
+void os__walk_read_dir(os__walk_worker_t *worker, str_t path) {
+    arena_t scratch = worker->scratch;
+    bool streaming = worker->walk->desc.callback != NULL;
+
+    str_t pattern = str_fmt(&scratch, "%v/*", path);
+    tstr_t winpattern = strv_to_tstr(&scratch, strv(pattern));
+
+    WIN32_FIND_DATA fd = {0};
+    // basic info skips the short 8.3 names, large fetch asks for bigger batches
+    HANDLE handle = FindFirstFileEx(
+        winpattern.buf,
+        (FINDEX_INFO_LEVELS)1, // FindExInfoBasic
+        &fd,
+        FindExSearchNameMatch,
+        NULL,
+        FIND_FIRST_EX_LARGE_FETCH
+    );
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    arena_t name_arena = scratch;
+
+    do {
+        TCHAR *name = fd.cFileName;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        scratch = name_arena;
+        str_t utf8_name = str_from_tstr(&scratch, tstr_init(name, 0));
+
+        bool is_dir = fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY;
+        bool is_link = fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT;
+        bool queued = is_dir && !is_link;
+
+        // with a callback only the directories that still have to be read are
+        // kept, so memory doesn't grow with the number of files
+        arena_t *path_arena = streaming && !queued ? &scratch : &worker->arena;
+
+        os_walk_entry_t entry = {
+            .path = str_fmt(path_arena, "%v/%v", path, utf8_name),
+            .type = is_dir ? DIRTYPE_DIR : DIRTYPE_FILE,
+        };
+
+        if (!is_dir) {
+            LARGE_INTEGER filesize = {
+                .LowPart  = fd.nFileSizeLow,
+                .HighPart = fd.nFileSizeHigh,
+            };
+            entry.file_size = filesize.QuadPart;
+        }
+
+        os__walk_emit(worker, &entry);
+
+        if (queued) {
+            os__walk_dir_t *dir = alloc(&worker->arena, os__walk_dir_t);
+            dir->path = entry.path;
+            os__walk_push_dir(worker->walk, dir);
+        }
+    } while (FindNextFile(handle, &fd));
+
+    FindClose(handle);
+}
+
+int os__walk_worker(u64 thread_id, void *userdata) {
+    COLLA_UNUSED(thread_id);
+    os__walk_worker_t *worker = userdata;
+    os__walk_t *walk = worker->walk;
+
+    while (true) {
+        WaitForSingleObject(walk->semaphore, INFINITE);
+
+        EnterCriticalSection(&walk->lock);
+        os__walk_dir_t *dir = walk->queue;
+        list_pop(walk->queue);
+        bool done = walk->done;
+        LeaveCriticalSection(&walk->lock);
+
+        if (!dir) {
+            if (done) break;
+            continue;
+        }
+
+        os__walk_read_dir(worker, dir->path);
+
+        EnterCriticalSection(&walk->lock);
+        walk->outstanding--;
+        done = walk->outstanding == 0;
+        walk->done |= done;
+        LeaveCriticalSection(&walk->lock);
+
+        // nothing left anywhere, wake everyone up so they can quit
+        if (done) {
+            ReleaseSemaphore(walk->semaphore, walk->thread_count, NULL);
+        }
+    }
+
+    return 0;
+}
+
+os_walk_result_t os_dir_walk(arena_t *arena, strview_t root, const os_walk_desc_t *desc) {
+    os_walk_result_t result = {0};
+
+    os__walk_t walk = {
+        .desc = desc ? *desc : (os_walk_desc_t){0},
+    };
+
+    walk.thread_count = walk.desc.thread_count ? walk.desc.thread_count : w32_data.info.processor_count;
+    walk.thread_count = MAX(walk.thread_count, 1);
+
+    walk.semaphore = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+    if (!walk.semaphore) {
+        err("couldn't create semaphore for directory walk: %v", os_get_error_string(os_get_last_error()));
+        return result;
+    }
+    InitializeCriticalSection(&walk.lock);
+
+    arena_t scratch = *arena;
+    os__walk_worker_t *workers = alloc(&scratch, os__walk_worker_t, walk.thread_count);
+    oshandle_t *threads = alloc(&scratch, oshandle_t, walk.thread_count);
+
+    // drop the trailing slash, paths are joined with '/'
+    while (root.len > 1 && (root.buf[root.len - 1] == '/' || root.buf[root.len - 1] == '\\')) {
+        root.len--;
+    }
+
+    os__walk_dir_t first = { .path = str(&scratch, root) };
+    os__walk_push_dir(&walk, &first);
+
+    u32 launched = 0;
+    for (u32 i = 0; i < walk.thread_count; ++i) {
+        workers[i].walk = &walk;
+        workers[i].arena = arena_make(ARENA_VIRTUAL, GB(64));
+        workers[i].scratch = arena_make(ARENA_VIRTUAL, MB(4));
+        threads[i] = os_thread_launch(os__walk_worker, &workers[i]);
+        if (!os_handle_valid(threads[i])) {
+            arena_cleanup(&workers[i].arena);
+            arena_cleanup(&workers[i].scratch);
+            break;
+        }
+        launched++;
+    }
+
+    if (launched == 0) {
+        // nobody to do the work, do it on this thread
+        workers[0].arena = arena_make(ARENA_VIRTUAL, GB(64));
+        workers[0].scratch = arena_make(ARENA_VIRTUAL, MB(4));
+        walk.thread_count = 1;
+        walk.done = false;
+        os__walk_worker(0, &workers[0]);
+        launched = 1;
+    }
+    else {
+        for (u32 i = 0; i < launched; ++i) {
+            os_thread_join(threads[i], NULL);
+        }
+    }
+
+    CloseHandle(walk.semaphore);
+    DeleteCriticalSection(&walk.lock);
+
+    // flatten everything in the caller's arena, after the temporary data
+    usize total = 0;
+    for (u32 i = 0; i < launched; ++i) {
+        total += workers[i].count;
+    }
+
+    if (total) {
+        result.entries = alloc(&scratch, os_walk_entry_t, total, ALLOC_NOZERO);
+        for (u32 i = 0; i < launched; ++i) {
+            for_each (chunk, workers[i].chunks) {
+                for (usize k = 0; k < chunk->count; ++k) {
+                    os_walk_entry_t *entry = &result.entries[result.count++];
+                    *entry = chunk->entries[k];
+                    entry->path = str_dup(&scratch, entry->path);
+                }
+            }
+        }
+    }
+
+    for (u32 i = 0; i < launched; ++i) {
+        arena_cleanup(&workers[i].arena);
+        arena_cleanup(&workers[i].scratch);
+    }
+
+    *arena = scratch;
+
+    return result;
+}
+
 // == PROCESS ===================================
 
 struct os_env_t {
@@ -574,14 +1531,60 @@ bool os_release(void *ptr, usize size) {
     return VirtualFree(ptr, 0, MEM_RELEASE);
 }
 
+// == TIME ======================================
+
+u64 os_now_ns(void) {
+    static LARGE_INTEGER frequency = {0};
+    if (!frequency.QuadPart) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter = {0};
+    QueryPerformanceCounter(&counter);
+
+    // split it up so counter * 1e9 can't overflow
+    u64 ticks = (u64)counter.QuadPart;
+    u64 freq = (u64)frequency.QuadPart;
+    return (ticks / freq) * 1000000000ull + (ticks % freq) * 1000000000ull / freq;
+}
+
+void os_sleep_ms(u32 milliseconds) {
+    Sleep(milliseconds);
+}
+
+typedef LONG (NTAPI os__win_query_timer_resolution_fn)(ULONG *minimum, ULONG *maximum, ULONG *current);
+
+// NtQueryTimerResolution isn't in any import library, it's loaded from ntdll
+u64 os__sleep_granularity_ns(void) {
+    HMODULE ntdll = GetModuleHandleA("ntdll.dll");
+    os__win_query_timer_resolution_fn *query = ntdll ? (os__win_query_timer_resolution_fn *)GetProcAddress(ntdll, "NtQueryTimerResolution") : NULL;
+
+    // in 100ns units
+    ULONG minimum = 0, maximum = 0, current = 0;
+    if (!query || query(&minimum, &maximum, &current) != 0 || !current) {
+        // the default 64hz tick
+        return 15625000ull;
+    }
+
+    return (u64)current * 100;
+}
+
 // == THREAD ====================================
 
+// implemented in metrics.c
+void metrics__thread_exit(void);
+
 DWORD os__win_thread_entry_point(void *ptr) {
     os_entity_t *entity = (os_entity_t *)ptr;
     thread_func_t *func = entity->thread.func;
     void *userdata = entity->thread.userdata;
     u64 id = entity->thread.id;
-    return func(id, userdata);
+    int code = func(id, userdata);
+    // whatever the thread printed last would be lost with its thread locals
+    fmt_flush();
+    os__win_thread_exit();
+    metrics__thread_exit();
+    return code;
 }
 
 oshandle_t os_thread_launch(thread_func_t func, void *userdata) {
@@ -591,6 +1594,11 @@ oshandle_t os_thread_launch(thread_func_t func, void *userdata) {
     entity->thread.userdata = userdata;
     entity->thread.handle = CreateThread(NULL, 0, os__win_thread_entry_point, entity, 0, &entity->thread.id);
 
+    if (!entity->thread.handle) {
+        os__win_free_entity(entity);
+        return os_handle_zero();
+    }
+
     return (oshandle_t){ (uptr)entity };
 }
 
@@ -653,6 +1661,59 @@ bool os_mutex_try_lock(oshandle_t mutex) {
     return TryEnterCriticalSection(&entity->mutex);
 }
 
+// == FUTEX =====================================
+
+typedef BOOL (WINAPI os__win_wait_on_address_fn)(volatile void *, void *, SIZE_T, DWORD);
+typedef void (WINAPI os__win_wake_by_address_fn)(void *);
+
+// WaitOnAddress is only available from windows 8, so it is loaded at runtime
+struct {
+    os__win_wait_on_address_fn *wait;
+    os__win_wake_by_address_fn *wake_one;
+    os__win_wake_by_address_fn *wake_all;
+} os__win_futex = {0};
+
+void os__win_futex_load(void) {
+    HMODULE synch = LoadLibraryA("api-ms-win-core-synch-l1-2-0.dll");
+    if (!synch) {
+        return;
+    }
+    os__win_futex.wait     = (os__win_wait_on_address_fn *)GetProcAddress(synch, "WaitOnAddress");
+    os__win_futex.wake_one = (os__win_wake_by_address_fn *)GetProcAddress(synch, "WakeByAddressSingle");
+    os__win_futex.wake_all = (os__win_wake_by_address_fn *)GetProcAddress(synch, "WakeByAddressAll");
+    if (!os__win_futex.wait || !os__win_futex.wake_one || !os__win_futex.wake_all) {
+        memset(&os__win_futex, 0, sizeof(os__win_futex));
+    }
+}
+
+bool os_futex_wait(volatile u32 *addr, u32 expected, u32 milliseconds) {
+    if (os__win_futex.wait) {
+        if (os__win_futex.wait(addr, &expected, sizeof(expected), milliseconds)) {
+            return true;
+        }
+        return GetLastError() != ERROR_TIMEOUT;
+    }
+
+    // without WaitOnAddress (or before os_init) just give up the time slice,
+    // the callers always check again anyway
+    if (*addr == expected) {
+        Sleep(milliseconds ? 1 : 0);
+    }
+    return true;
+}
+
+void os_futex_wake_one(volatile u32 *addr) {
+    if (os__win_futex.wake_one) {
+        os__win_futex.wake_one((void *)addr);
+    }
+}
+
+void os_futex_wake_all(volatile u32 *addr) {
+    if (os__win_futex.wake_all) {
+        os__win_futex.wake_all((void *)addr);
+    }
+}
+
 #if !COLLA_NO_CONDITION_VARIABLE
 
 // == CONDITION VARIABLE ========================